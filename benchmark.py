@@ -1,6 +1,6 @@
 #!/usr/bin/env python3
 """
-Benchmark comparisons for five methods to obtain the K smallest items from a list,
+Benchmark comparisons for seven methods to obtain the K smallest items from a list,
 for various values of K with different list sizes N (varying from 1,000 to 1,000,000).
 
 For each method and each chosen K (as a percentage of N), the test is run 5 times
@@ -12,6 +12,8 @@ Methods benchmarked:
   3. Using quickselect: partition the list with selectlib.quickselect and then sort the first K elements.
   4. Using heapselect: partition the list with selectlib.heapselect and then sort the first K elements.
   5. Using nth_element: partition the list with selectlib.nth_element and then sort the first K elements.
+  6. Using partial_sort: sort the first K elements in place with selectlib.partial_sort and slice them.
+  7. Using selectlib.nsmallest: the drop-in replacement for heapq.nsmallest.
 
 The benchmark results are then plotted as grouped bar charts (one per N value) in a vertical stack.
 Note: The percentages for K are now 0.2%, 1%, 10%, and 25% of N.
@@ -76,6 +78,22 @@ def bench_nth_element(values, K):
     return result
 
 
+def bench_partial_sort(values, K):
+    """
+    Use selectlib.partial_sort on a copy of the list so that its first K elements are the K smallest
+    in sorted order; then return them.
+    """
+    lst = values.copy()
+    selectlib.partial_sort(lst, K)
+    return lst[:K]
+
+
+def bench_selectlib_nsmallest(values, K):
+    """Use selectlib.nsmallest on a copy of the list to obtain the first K smallest items."""
+    lst = values.copy()
+    return selectlib.nsmallest(K, lst)
+
+
 # Dictionary of methods to benchmark.
 methods = {
     'sort': bench_sort,
@@ -83,6 +101,8 @@ methods = {
     'quickselect': bench_quickselect,
     'heapselect': bench_heapselect,
     'nth_element': bench_nth_element,
+    'partial_sort': bench_partial_sort,
+    'selectlib.nsmallest': bench_selectlib_nsmallest,
 }
 
 
@@ -125,7 +145,7 @@ def run_benchmarks():
                 results[name][K] = med
                 times_ms = [f'{t * 1000:,.3f}' for t in times]
                 print(
-                    f'    {name:15}: median = {med * 1000:,.3f} ms  (runs: {times_ms} ms)'
+                    f'    {name:19}: median = {med * 1000:,.3f} ms  (runs: {times_ms} ms)'
                 )
         overall_results[N] = {'K_values': K_VALUES, 'results': results}
     return overall_results
@@ -145,13 +165,15 @@ def plot_results(overall_results):
         axes = [axes]
 
     # Bar appearance settings
-    bar_width = 0.15
+    bar_width = 0.11
     method_offsets = {
-        'sort': -2 * bar_width,
-        'heapq.nsmallest': -bar_width,
-        'quickselect': 0,
-        'heapselect': bar_width,
-        'nth_element': 2 * bar_width,
+        'sort': -3 * bar_width,
+        'heapq.nsmallest': -2 * bar_width,
+        'quickselect': -1 * bar_width,
+        'heapselect': 0,
+        'nth_element': bar_width,
+        'partial_sort': 2 * bar_width,
+        'selectlib.nsmallest': 3 * bar_width,
     }
     method_colors = {
         'sort': '#1f77b4',
@@ -159,6 +181,8 @@ def plot_results(overall_results):
         'quickselect': '#2ca02c',
         'heapselect': '#d62728',
         'nth_element': '#9467bd',
+        'partial_sort': '#8c564b',
+        'selectlib.nsmallest': '#e377c2',
     }
 
     # Process each chart (one per N value)
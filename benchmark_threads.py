@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""
+Benchmark the thread scaling of selectlib.nth_element on large numeric buffers.
+
+For each buffer size (10,000,000 and 100,000,000 doubles) the script fills an
+array.array('d') with random values and times selectlib.nth_element at the
+median index with threads=1, 2, 4 and 8. Each configuration is run 5 times
+on a fresh copy of the buffer and the median runtime is recorded.
+
+The results are printed together with the speedup relative to one thread and
+then displayed as a grouped bar chart with one group per buffer size.
+"""
+
+import array
+import random
+import timeit
+import statistics
+import matplotlib.pyplot as plt
+import selectlib
+
+THREAD_COUNTS = [1, 2, 4, 8]
+
+
+def bench_nth_element(values, threads):
+    """
+    Uses selectlib.nth_element on a copy of the buffer to position the median,
+    partitioning in parallel on the given number of threads.
+    """
+    buf = array.array('d', values)
+    median_index = (len(buf) - 1) // 2
+    selectlib.nth_element(buf, median_index, threads=threads)
+    return buf[median_index]
+
+
+def run_benchmarks():
+    """
+    Runs the benchmarks for various buffer sizes.
+    Returns a dictionary mapping each buffer size to {threads: median time}.
+    """
+    N_values = [10_000_000, 100_000_000]
+
+    overall_results = {}  # {N: {threads: time_in_seconds, ...}}
+
+    for N in N_values:
+        print(f'\nBenchmarking for N = {N:,}')
+        original = array.array('d', (random.random() for _ in range(N)))
+
+        results = {}
+        for threads in THREAD_COUNTS:
+
+            def test_callable():
+                return bench_nth_element(original, threads)
+
+            times = timeit.repeat(stmt=test_callable, repeat=5, number=1)
+            med_time = statistics.median(times)
+            results[threads] = med_time
+            speedup = results[1] / med_time
+            print(
+                f'  threads={threads}: median = {med_time * 1000:,.3f} ms'
+                f'  (speedup {speedup:.2f}x)'
+            )
+        overall_results[N] = results
+    return overall_results
+
+
+def plot_results(results):
+    """
+    Creates a grouped bar chart.
+    Each group corresponds to a buffer size N and each bar to a thread count.
+    """
+    N_values = sorted(results.keys())
+    group_positions = list(range(len(N_values)))
+    bar_width = 0.18
+
+    plt.figure(figsize=(10, 6))
+    for i, threads in enumerate(THREAD_COUNTS):
+        offset = (i - (len(THREAD_COUNTS) - 1) / 2) * bar_width
+        times_ms = [results[N][threads] * 1000 for N in N_values]
+        positions = [pos + offset for pos in group_positions]
+        bars = plt.bar(positions, times_ms, width=bar_width, label=f'{threads}')
+        plt.bar_label(bars, fmt='%.2f', padding=3, fontsize=8)
+
+    plt.xticks(group_positions, [f'{N:,}' for N in N_values])
+    plt.xlabel('Buffer size (N)')
+    plt.ylabel('Time (ms)')
+    plt.title('Benchmark: selectlib.nth_element median on array("d") by thread count')
+    plt.legend(title='Threads')
+    plt.grid(True, linestyle='--', alpha=0.5)
+    plt.tight_layout()
+    plt.savefig('plot_threads.png')
+    plt.show()
+
+
+if __name__ == '__main__':
+    bench_results = run_benchmarks()
+    plot_results(bench_results)
@@ -2,6 +2,8 @@
 #include <Python.h>
 #include <listobject.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include <math.h>
 
@@ -13,38 +15,495 @@
 #define SELECTLIB_VERSION "1.0.4"
 #endif
 
-/* Forward declaration for heapselect so that it can be used
-   in quickselect's fallback if the iteration limit is exceeded.
+#if PY_VERSION_HEX < 0x030B0000
+#include <longintrepr.h>
+#endif
+
+/* Access to the value of a single-digit ("compact") int. CPython 3.12
+   changed the PyLongObject layout and added accessors for this.
+*/
+#if PY_VERSION_HEX >= 0x030C0000
+#define SELECTLIB_LONG_IS_COMPACT(op) \
+    PyUnstable_Long_IsCompact((PyLongObject *)(op))
+#define SELECTLIB_LONG_COMPACT_VALUE(op) \
+    PyUnstable_Long_CompactValue((PyLongObject *)(op))
+#else
+#define SELECTLIB_LONG_IS_COMPACT(op) (Py_ABS(Py_SIZE(op)) <= 1)
+#define SELECTLIB_LONG_COMPACT_VALUE(op) \
+    ((Py_ssize_t)Py_SIZE(op) * (Py_ssize_t)((PyLongObject *)(op))->ob_digit[0])
+#endif
+
+/* Py_SET_SIZE was added in Python 3.9. */
+#if PY_VERSION_HEX < 0x03090000 && !defined(Py_SET_SIZE)
+#define Py_SET_SIZE(ob, size) (((PyVarObject *)(ob))->ob_size = (size))
+#endif
+
+/*
+   Comparison state, chosen once per call by select_state_init().
+   Like the pre-sort scan in CPython's list.sort(), a single pass over the
+   values (or keys) detects homogeneous inputs so that each comparison can
+   skip the generic rich-compare dispatch.
+*/
+typedef struct SelectState SelectState;
+struct SelectState {
+    int (*key_compare)(PyObject *, PyObject *, SelectState *);
+    /* Used by the tuple compares for the tuples' first elements. */
+    int (*tuple_elem_compare)(PyObject *, PyObject *, SelectState *);
+    richcmpfunc key_richcompare;
+    /* Select in descending order: less_than() swaps its operands. */
+    int reverse;
+};
+
+/* Generic comparison, safe for any mix of types. */
+static int
+safe_object_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    return PyObject_RichCompareBool(v, w, Py_LT);
+}
+
+/* All keys share one type: call its tp_richcompare slot directly. */
+static int
+unsafe_object_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    PyObject *res_obj;
+    int res;
+
+    if (Py_TYPE(v)->tp_richcompare != st->key_richcompare)
+        return PyObject_RichCompareBool(v, w, Py_LT);
+
+    res_obj = (*(st->key_richcompare))(v, w, Py_LT);
+    if (res_obj == Py_NotImplemented) {
+        Py_DECREF(res_obj);
+        return PyObject_RichCompareBool(v, w, Py_LT);
+    }
+    if (res_obj == NULL)
+        return -1;
+    if (PyBool_Check(res_obj))
+        res = (res_obj == Py_True);
+    else
+        res = PyObject_IsTrue(res_obj);
+    Py_DECREF(res_obj);
+    return res;
+}
+
+/* All keys are exact ints that fit in a single digit: compare the digits. */
+static int
+unsafe_long_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    return SELECTLIB_LONG_COMPACT_VALUE(v) < SELECTLIB_LONG_COMPACT_VALUE(w);
+}
+
+/* All keys are exact floats: compare the C doubles. */
+static int
+unsafe_float_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    return PyFloat_AS_DOUBLE(v) < PyFloat_AS_DOUBLE(w);
+}
+
+/* All keys are exact str objects with 1-byte (latin-1) storage: memcmp. */
+static int
+unsafe_latin_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    Py_ssize_t len;
+    int res;
+
+    len = Py_MIN(PyUnicode_GET_LENGTH(v), PyUnicode_GET_LENGTH(w));
+    res = memcmp(PyUnicode_DATA(v), PyUnicode_DATA(w), len);
+    res = (res != 0 ?
+           res < 0 :
+           PyUnicode_GET_LENGTH(v) < PyUnicode_GET_LENGTH(w));
+    return res;
+}
+
+/* All keys are exact bytes objects: memcmp. */
+static int
+unsafe_bytes_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    Py_ssize_t len;
+    int res;
+
+    len = Py_MIN(PyBytes_GET_SIZE(v), PyBytes_GET_SIZE(w));
+    res = memcmp(PyBytes_AS_STRING(v), PyBytes_AS_STRING(w), len);
+    res = (res != 0 ?
+           res < 0 :
+           PyBytes_GET_SIZE(v) < PyBytes_GET_SIZE(w));
+    return res;
+}
+
+/*
+   All keys are non-empty tuples. As in CPython's listsort, find the first
+   index where the tuples differ with Py_EQ and only order that element;
+   the first elements use tuple_elem_compare.
+*/
+static int
+unsafe_tuple_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    Py_ssize_t i, vlen, wlen, len;
+    int k;
+
+    vlen = PyTuple_GET_SIZE(v);
+    wlen = PyTuple_GET_SIZE(w);
+    len = Py_MIN(vlen, wlen);
+    for (i = 0; i < len; i++) {
+        k = PyObject_RichCompareBool(PyTuple_GET_ITEM(v, i),
+                                     PyTuple_GET_ITEM(w, i), Py_EQ);
+        if (k < 0)
+            return -1;
+        if (!k)
+            break;
+    }
+
+    if (i >= len)
+        return vlen < wlen;
+    if (i == 0)
+        return st->tuple_elem_compare(PyTuple_GET_ITEM(v, 0),
+                                      PyTuple_GET_ITEM(w, 0), st);
+    return PyObject_RichCompareBool(PyTuple_GET_ITEM(v, i),
+                                    PyTuple_GET_ITEM(w, i), Py_LT);
+}
+
+/*
+   All keys are non-empty tuples whose first elements share one of the typed
+   compares above (int, float, str or bytes). Those are total orders, so the
+   first elements are ordered with at most two typed compares and the full
+   tuple comparison only runs when they tie (or are unordered, e.g. NaN).
+*/
+static int
+unsafe_typed_tuple_compare(PyObject *v, PyObject *w, SelectState *st)
+{
+    PyObject *v0 = PyTuple_GET_ITEM(v, 0);
+    PyObject *w0 = PyTuple_GET_ITEM(w, 0);
+
+    if (st->tuple_elem_compare(v0, w0, st))
+        return 1;
+    if (st->tuple_elem_compare(w0, v0, st))
+        return 0;
+    return PyObject_RichCompareBool(v, w, Py_LT);
+}
+
+/*
+   Scan the keys (or the list items when keys is NULL) once and pick the
+   cheapest comparison that is valid for all of them. For lists of non-empty
+   tuples the scan looks at the tuples' first elements instead.
+   With reverse set, the comparisons order the keys from largest to smallest.
 */
-static PyObject * selectlib_heapselect(PyObject *self, PyObject *args, PyObject *kwargs);
+static void
+select_state_init(SelectState *st, PyObject **items, PyObject **keys, Py_ssize_t n,
+                  int reverse)
+{
+    st->reverse = reverse;
+    st->key_compare = safe_object_compare;
+    st->tuple_elem_compare = safe_object_compare;
+    st->key_richcompare = NULL;
+    if (n < 2)
+        return;
+
+    PyObject *first = keys ? keys[0] : items[0];
+    int keys_are_in_tuples = (Py_TYPE(first) == &PyTuple_Type &&
+                              PyTuple_GET_SIZE(first) > 0);
+    PyTypeObject *key_type = Py_TYPE(keys_are_in_tuples ?
+                                     PyTuple_GET_ITEM(first, 0) : first);
+    int keys_are_all_same_type = 1;
+    int ints_are_bounded = 1;
+    int strings_are_latin = 1;
+
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *key = keys ? keys[i] : items[i];
+        if (keys_are_in_tuples) {
+            if (Py_TYPE(key) != &PyTuple_Type || PyTuple_GET_SIZE(key) == 0)
+                return;
+            key = PyTuple_GET_ITEM(key, 0);
+        }
+        if (Py_TYPE(key) != key_type) {
+            keys_are_all_same_type = 0;
+            /* Tuples are still worth checking all the way through. */
+            if (!keys_are_in_tuples)
+                return;
+            continue;
+        }
+        if (key_type == &PyLong_Type && ints_are_bounded &&
+            !SELECTLIB_LONG_IS_COMPACT(key))
+            ints_are_bounded = 0;
+        else if (key_type == &PyUnicode_Type && strings_are_latin &&
+                 PyUnicode_KIND(key) != PyUnicode_1BYTE_KIND)
+            strings_are_latin = 0;
+    }
+
+    if (keys_are_all_same_type) {
+        if (key_type == &PyLong_Type && ints_are_bounded) {
+            st->key_compare = unsafe_long_compare;
+        }
+        else if (key_type == &PyFloat_Type) {
+            st->key_compare = unsafe_float_compare;
+        }
+        else if (key_type == &PyUnicode_Type && strings_are_latin) {
+            st->key_compare = unsafe_latin_compare;
+        }
+        else if (key_type == &PyBytes_Type) {
+            st->key_compare = unsafe_bytes_compare;
+        }
+        else if (key_type->tp_richcompare != NULL) {
+            st->key_compare = unsafe_object_compare;
+            st->key_richcompare = key_type->tp_richcompare;
+        }
+    }
+
+    if (keys_are_in_tuples) {
+        int typed = (st->key_compare != safe_object_compare &&
+                     st->key_compare != unsafe_object_compare);
+        st->tuple_elem_compare = st->key_compare;
+        st->key_compare = typed ? unsafe_typed_tuple_compare : unsafe_tuple_compare;
+    }
+}
 
 /*
-   Helper function that compares two PyObject*s using the < operator.
+   Helper function that compares two PyObject*s using the < operator, or
+   the > operator when selecting in reverse order.
    Returns 1 if a < b, 0 if not, or -1 if an error occurred.
 */
 static int
-less_than(PyObject *a, PyObject *b)
+less_than(PyObject *a, PyObject *b, SelectState *st)
 {
-    int cmp = PyObject_RichCompareBool(a, b, Py_LT);
-    return cmp;
+    if (st->reverse)
+        return st->key_compare(b, a, st);
+    return st->key_compare(a, b, st);
 }
 
 /*
-   Swap the elements at indices i and j in the Python list.
-   If keys is not NULL, also swap the corresponding keys.
-   This version uses the official Python C-API (PyList_GetItem/PyList_SetItem)
-   to avoid direct access to the ob_item field.
+   Three-way comparison of a and b: stores -1, 0 or 1 in *result as a is
+   less than, equal to, or greater than b. Ints, latin-1 strings and bytes
+   are compared in a single step. Anything else costs one less_than() call
+   when a < b and two otherwise, which averages 1.5 when partitioning
+   around a median.
+   In reverse order, b is compared to a instead.
+   Returns 0 on success or -1 if a comparison raised.
+*/
+static int
+three_way_compare(PyObject *a, PyObject *b, int *result, SelectState *st)
+{
+    if (st->reverse) {
+        PyObject *tmp = a;
+        a = b;
+        b = tmp;
+    }
+    if (st->key_compare == unsafe_long_compare) {
+        Py_ssize_t x = SELECTLIB_LONG_COMPACT_VALUE(a);
+        Py_ssize_t y = SELECTLIB_LONG_COMPACT_VALUE(b);
+        *result = (x > y) - (x < y);
+        return 0;
+    }
+    if (st->key_compare == unsafe_latin_compare) {
+        Py_ssize_t alen = PyUnicode_GET_LENGTH(a), blen = PyUnicode_GET_LENGTH(b);
+        int res = memcmp(PyUnicode_DATA(a), PyUnicode_DATA(b), Py_MIN(alen, blen));
+        *result = res != 0 ? (res > 0) - (res < 0) : (alen > blen) - (alen < blen);
+        return 0;
+    }
+    if (st->key_compare == unsafe_bytes_compare) {
+        Py_ssize_t alen = PyBytes_GET_SIZE(a), blen = PyBytes_GET_SIZE(b);
+        int res = memcmp(PyBytes_AS_STRING(a), PyBytes_AS_STRING(b), Py_MIN(alen, blen));
+        *result = res != 0 ? (res > 0) - (res < 0) : (alen > blen) - (alen < blen);
+        return 0;
+    }
+
+    int cmp = st->key_compare(a, b, st);
+    if (cmp < 0)
+        return -1;
+    if (cmp) {
+        *result = -1;
+        return 0;
+    }
+    cmp = st->key_compare(b, a, st);
+    if (cmp < 0)
+        return -1;
+    *result = cmp;
+    return 0;
+}
+
+/* ---------- detaching the list during selection ---------- */
+
+/*
+   While a list is being selected on, its item array is detached from the
+   list object, as list.sort() does: the list appears empty to key functions
+   and comparisons, and anything they add to it is discarded. This lets the
+   selection code read and swap the item pointers directly, without having to
+   check after every comparison that the list still has the same items.
+*/
+typedef struct {
+    PyListObject *list;
+    PyObject **items;
+    Py_ssize_t size;
+    Py_ssize_t allocated;
+} DetachedList;
+
+/* Detach the items of list and return them. */
+static PyObject **
+list_detach(DetachedList *dl, PyObject *list)
+{
+    PyListObject *lp = (PyListObject *)list;
+    dl->list = lp;
+    dl->items = lp->ob_item;
+    dl->size = Py_SIZE(lp);
+    dl->allocated = lp->allocated;
+
+    Py_SET_SIZE(lp, 0);
+    lp->ob_item = NULL;
+    lp->allocated = -1;  /* any operation will reset it to >= 0 */
+    return dl->items;
+}
+
+/*
+   Give the list its items back, discarding anything that was stored in it
+   while it was detached.
+   Returns 0, or -1 with ValueError set if the list was modified meanwhile
+   (an exception that is already set is left in place).
+*/
+static int
+list_reattach(DetachedList *dl)
+{
+    PyListObject *lp = dl->list;
+    PyObject **final_items = lp->ob_item;
+    Py_ssize_t final_size = Py_SIZE(lp);
+    int modified = (lp->allocated != -1);
+
+    Py_SET_SIZE(lp, dl->size);
+    lp->ob_item = dl->items;
+    lp->allocated = dl->allocated;
+
+    if (final_items != NULL) {
+        /* Decref in reverse order, as list_dealloc does. */
+        for (Py_ssize_t i = final_size; --i >= 0; )
+            Py_XDECREF(final_items[i]);
+        PyMem_Free(final_items);
+    }
+    if (modified) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(PyExc_ValueError, "list modified during selection");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+   Call key on each of the n items and return a new array of the results,
+   or NULL with an exception set.
+*/
+static PyObject **
+compute_keys(PyObject *key, PyObject **items, Py_ssize_t n)
+{
+    PyObject **keys = PyMem_New(PyObject *, n);
+    if (keys == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        PyObject *keyval = PyObject_CallFunctionObjArgs(key, items[i], NULL);
+        if (keyval == NULL) {
+            for (Py_ssize_t j = 0; j < i; j++)
+                Py_DECREF(keys[j]);
+            PyMem_Free(keys);
+            return NULL;
+        }
+        keys[i] = keyval;
+    }
+    return keys;
+}
+
+/*
+   Functions that return values select on a scratch copy of the item
+   pointers, which leaves the caller's order alone. The copy of a list holds
+   a reference to each item, so the list stays usable by other code (key
+   functions, comparisons, other threads) while it is selected on, and
+   whatever they do to it cannot free the items; a tuple cannot change, so
+   its copy needs no references of its own. A scratch array of up to SCRATCH_KEEP_MAX items is kept
+   between calls, so repeated selections on small and medium inputs skip
+   the allocation; larger inputs, and calls made while it is in use (from a
+   key function, say), get a fresh array that is freed on release.
+*/
+static PyObject **scratch_items = NULL;
+static Py_ssize_t scratch_allocated = 0;
+static int scratch_in_use = 0;
+
+/* Largest scratch array kept between calls, in items (2 MB of pointers). */
+#ifndef SCRATCH_KEEP_MAX
+#define SCRATCH_KEEP_MAX (1 << 18)
+#endif
+
+/*
+   Return a scratch array holding a copy of the n item pointers items, with
+   a new reference to each if own is set, or NULL with MemoryError set.
+   Release it with scratch_release() and the same n and own.
 */
+static PyObject **
+scratch_copy(PyObject **items, Py_ssize_t n, int own)
+{
+    PyObject **scratch;
+    if (!scratch_in_use && n > 0 && n <= SCRATCH_KEEP_MAX) {
+        if (n > scratch_allocated) {
+            PyMem_Free(scratch_items);
+            scratch_allocated = 0;
+            scratch_items = PyMem_New(PyObject *, n);
+            if (scratch_items == NULL) {
+                PyErr_NoMemory();
+                return NULL;
+            }
+            scratch_allocated = n;
+        }
+        scratch_in_use = 1;
+        scratch = scratch_items;
+    }
+    else {
+        scratch = PyMem_New(PyObject *, n > 0 ? n : 1);
+        if (scratch == NULL) {
+            PyErr_NoMemory();
+            return NULL;
+        }
+    }
+    /* An empty list has no item array to copy from. */
+    if (n > 0)
+        memcpy(scratch, items, (size_t)n * sizeof(PyObject *));
+    if (own) {
+        for (Py_ssize_t i = 0; i < n; i++)
+            Py_INCREF(scratch[i]);
+    }
+    return scratch;
+}
+
+/* Release an array returned by scratch_copy(). */
+static void
+scratch_release(PyObject **scratch, Py_ssize_t n, int own)
+{
+    if (own) {
+        for (Py_ssize_t i = 0; i < n; i++)
+            Py_DECREF(scratch[i]);
+    }
+    if (scratch == scratch_items)
+        scratch_in_use = 0;
+    else
+        PyMem_Free(scratch);
+}
+
+/* Release an array returned by compute_keys(); objects may be NULL. */
 static void
-swap_items(PyObject *list, Py_ssize_t i, Py_ssize_t j, PyObject **keys)
+free_objects(PyObject **objects, Py_ssize_t n)
 {
-    PyObject *temp = PyList_GetItem(list, i);
-    Py_INCREF(temp);
-    PyObject *item_j = PyList_GetItem(list, j);
-    Py_INCREF(item_j);
+    if (objects == NULL)
+        return;
+    for (Py_ssize_t i = 0; i < n; i++)
+        Py_DECREF(objects[i]);
+    PyMem_Free(objects);
+}
 
-    PyList_SetItem(list, i, item_j);  /* Steals reference of item_j */
-    PyList_SetItem(list, j, temp);    /* Steals reference of temp */
+/*
+   Swap the item pointers at indices i and j of a detached item array.
+   If keys is not NULL, also swap the corresponding keys.
+   No reference counts change.
+*/
+static inline void
+swap_items(PyObject **items, Py_ssize_t i, Py_ssize_t j, PyObject **keys)
+{
+    PyObject *temp = items[i];
+    items[i] = items[j];
+    items[j] = temp;
 
     if (keys != NULL) {
         PyObject *temp_key = keys[i];
@@ -54,484 +513,3153 @@ swap_items(PyObject *list, Py_ssize_t i, Py_ssize_t j, PyObject **keys)
 }
 
 /*
-   Standard in‐place three‐way partition (Dutch National Flag style) based on a given pivot.
-   Rearranges the list (and keys array if present) so that all elements whose key is less than
-   pivot come first, followed by those equal to pivot, then those greater.
-   Upon return, *low is the first index of the "equal" section and *mid is one past its end.
+   Standard in‐place three‐way partition (Dutch National Flag style) based on a given pivot.
+   Rearranges the list (and keys array if present) so that all elements whose key is less than
+   pivot come first, followed by those equal to pivot, then those greater.
+   Upon return, *low is the first index of the "equal" section and *mid is one past its end.
+*/
+static int
+partition_by_pivot(PyObject **items, PyObject **keys, Py_ssize_t n, PyObject *pivot,
+                   Py_ssize_t *low, Py_ssize_t *mid, SelectState *st)
+{
+    Py_ssize_t i = 0, j = 0, k = n - 1;
+    int cmp;
+    while (j <= k) {
+        PyObject *current = keys ? keys[j] : items[j];
+        if (three_way_compare(current, pivot, &cmp, st) < 0)
+            return -1;
+        if (cmp < 0) {  /* current < pivot */
+            swap_items(items, i, j, keys);
+            i++; j++;
+        }
+        else if (cmp == 0) {  /* current == pivot */
+            j++;
+        }
+        else {  /* current > pivot */
+            swap_items(items, j, k, keys);
+            k--;
+        }
+    }
+    *low = i;
+    *mid = j;
+    return 0;
+}
+
+/*
+   Return a random index in [left, right] for use as a pivot.
+   The generator is seeded once in PyInit_selectlib rather than lazily, so
+   there is no first-call race when pivots are drawn with the GIL released.
+*/
+static Py_ssize_t
+random_index(Py_ssize_t left, Py_ssize_t right)
+{
+    return left + rand() % (right - left + 1);
+}
+
+/* Compute a max iteration limit for quickselect: 4 times (1 + log₂(n)).
+   Empty and single-item ranges (n < 2, possibly negative) get the limit of
+   one item rather than log(0). */
+static long
+quickselect_max_iter(Py_ssize_t n)
+{
+    if (n < 2)
+        return 4;
+    double log_val = log((double)n) / log(2.0);
+    return 4 * (1 + (long)log_val);
+}
+
+/* Number of items per side whose comparison results block_partition() buffers. */
+#define PARTITION_BLOCK 64
+
+/*
+   Hoare partition of [left, right] around the pivot stored at index left,
+   with BlockQuicksort-style batching: the comparison results for a block of
+   items at each end are first recorded as offsets of the items that belong
+   on the other side, and those items are then swapped pairwise in bulk.
+   This needs far fewer swaps than a Lomuto partition. Items equal to the
+   pivot may land on either side, which keeps runs of duplicates balanced.
+   The ends are finished with a plain Hoare scan.
+   On success the pivot is moved to its final index, stored in *pos.
+   Returns 0 on success or -1 if a comparison raised.
+*/
+static int
+block_partition(PyObject **items, PyObject **keys, Py_ssize_t left, Py_ssize_t right,
+                Py_ssize_t *pos, SelectState *st)
+{
+#define KEY_AT(i) (keys ? keys[i] : items[i])
+    PyObject *pivot = KEY_AT(left);
+    unsigned char offsets_l[PARTITION_BLOCK], offsets_r[PARTITION_BLOCK];
+    int num_l = 0, num_r = 0, start_l = 0, start_r = 0;
+    /* Items in (left, l) are <= pivot and items in (r, right] are >= pivot. */
+    Py_ssize_t l = left + 1, r = right;
+    int cmp;
+
+    while (r - l + 1 >= 2 * PARTITION_BLOCK) {
+        if (num_l == 0) {
+            start_l = 0;
+            for (int i = 0; i < PARTITION_BLOCK; i++) {
+                cmp = less_than(KEY_AT(l + i), pivot, st);
+                if (cmp < 0)
+                    return -1;
+                offsets_l[num_l] = (unsigned char)i;
+                num_l += !cmp;
+            }
+        }
+        if (num_r == 0) {
+            start_r = 0;
+            for (int i = 0; i < PARTITION_BLOCK; i++) {
+                cmp = less_than(pivot, KEY_AT(r - i), st);
+                if (cmp < 0)
+                    return -1;
+                offsets_r[num_r] = (unsigned char)i;
+                num_r += !cmp;
+            }
+        }
+        int num = Py_MIN(num_l, num_r);
+        for (int i = 0; i < num; i++)
+            swap_items(items, l + offsets_l[start_l + i], r - offsets_r[start_r + i], keys);
+        num_l -= num;
+        num_r -= num;
+        start_l += num;
+        start_r += num;
+        if (num_l == 0)
+            l += PARTITION_BLOCK;
+        if (num_r == 0)
+            r -= PARTITION_BLOCK;
+    }
+
+    /* Finish [l, r] with a plain Hoare scan; this may repeat the
+       comparisons of a partly swapped block. */
+    Py_ssize_t i = l, j = r;
+    for (;;) {
+        while (i <= j) {
+            cmp = less_than(KEY_AT(i), pivot, st);
+            if (cmp < 0)
+                return -1;
+            if (!cmp)
+                break;
+            i++;
+        }
+        while (i <= j) {
+            cmp = less_than(pivot, KEY_AT(j), st);
+            if (cmp < 0)
+                return -1;
+            if (!cmp)
+                break;
+            j--;
+        }
+        if (i >= j)
+            break;
+        swap_items(items, i, j, keys);
+        i++;
+        j--;
+    }
+#undef KEY_AT
+
+    /* Items in (left, j] are <= pivot and items in (j, right] are >= pivot. */
+    swap_items(items, left, j, keys);
+    *pos = j;
+    return 0;
+}
+
+static int quickselect_inplace(PyObject **items, PyObject **keys,
+                               Py_ssize_t left, Py_ssize_t right, Py_ssize_t k,
+                               SelectState *st);
+
+/* Insertion sort of the (at most a handful of) items in [left, right]. */
+static int
+insertion_sort_items(PyObject **items, PyObject **keys,
+                     Py_ssize_t left, Py_ssize_t right, SelectState *st)
+{
+    for (Py_ssize_t i = left + 1; i <= right; i++) {
+        for (Py_ssize_t j = i; j > left; j--) {
+            int cmp = less_than(keys ? keys[j] : items[j],
+                                keys ? keys[j - 1] : items[j - 1], st);
+            if (cmp < 0)
+                return -1;
+            if (!cmp)
+                break;
+            swap_items(items, j, j - 1, keys);
+        }
+    }
+    return 0;
+}
+
+/*
+   Deterministic pivot choice for [left, right] (Blum, Floyd, Pratt, Rivest
+   and Tarjan): the median of each group of five is moved to the front of the
+   range, and the median of those medians is selected recursively. At least
+   3/10 of the range lies on each side of that pivot, which bounds the total
+   work of the selection to O(n).
+   Stores the pivot's index in *pivot_index; returns 0, or -1 on error.
+*/
+static int
+median_of_medians(PyObject **items, PyObject **keys, Py_ssize_t left, Py_ssize_t right,
+                  Py_ssize_t *pivot_index, SelectState *st)
+{
+    Py_ssize_t n = right - left + 1;
+    if (n < 5) {
+        if (insertion_sort_items(items, keys, left, right, st) < 0)
+            return -1;
+        *pivot_index = left + n / 2;
+        return 0;
+    }
+
+    Py_ssize_t m = 0;
+    for (Py_ssize_t g = left; g + 4 <= right; g += 5, m++) {
+        if (insertion_sort_items(items, keys, g, g + 4, st) < 0)
+            return -1;
+        swap_items(items, left + m, g + 2, keys);
+    }
+    *pivot_index = left + m / 2;
+    return quickselect_inplace(items, keys, left, left + m - 1, *pivot_index, st);
+}
+
+/*
+   In‐place introselect. It partitions the list (and keys array if provided) so
+   that the element at index k is in its final sorted position, using
+   block_partition() around random pivots. If the number of iterations exceeds
+   4× the expected maximum recursion depth, the remaining range is finished
+   with median_of_medians() pivots, so the worst case stays linear and none of
+   the partitioning done so far is lost.
+   Returns 0 on success or -1 if a comparison raised.
+*/
+static int
+quickselect_inplace(PyObject **items, PyObject **keys,
+                    Py_ssize_t left, Py_ssize_t right, Py_ssize_t k,
+                    SelectState *st)
+{
+    int iterations = 0;
+    long max_iter = quickselect_max_iter(right - left + 1);
+
+    while (left < right) {
+        Py_ssize_t pivot_index;
+        Py_ssize_t pos;
+        if (iterations < max_iter) {
+            iterations++;
+            pivot_index = random_index(left, right);
+        }
+        else if (median_of_medians(items, keys, left, right, &pivot_index, st) < 0) {
+            return -1;
+        }
+        /* Move pivot to the front */
+        swap_items(items, pivot_index, left, keys);
+        if (block_partition(items, keys, left, right, &pos, st) < 0)
+            return -1;
+        if (pos == k)
+            return 0;
+        else if (k < pos)
+            right = pos - 1;
+        else
+            left = pos + 1;
+    }
+    return 0;
+}
+
+/* ---------- Floyd-Rivest selection ---------- */
+
+/* Ranges at most this long are left to quickselect. */
+#define FLOYD_RIVEST_CUTOFF 600
+
+/* nth_element uses Floyd-Rivest for sequences of at least this many items. */
+#ifndef FLOYD_RIVEST_MIN_SIZE
+#define FLOYD_RIVEST_MIN_SIZE 2048
+#endif
+
+/*
+   The sample window of Floyd and Rivest's SELECT ("Expected time bounds for
+   selection", CACM 1975) for index k of [left, right]: about n^(2/3) items
+   around k, offset so that selecting k within the window alone yields an
+   item very close in rank to the kth smallest of the whole range.
+*/
+static void
+floyd_rivest_sample(Py_ssize_t left, Py_ssize_t right, Py_ssize_t k,
+                    Py_ssize_t *sample_left, Py_ssize_t *sample_right)
+{
+    double n = (double)(right - left + 1);
+    double i = (double)(k - left + 1);
+    double z = log(n);
+    double s = 0.5 * exp(2.0 * z / 3.0);
+    double sd = 0.5 * sqrt(z * s * (n - s) / n) * (i < n / 2 ? -1.0 : 1.0);
+    *sample_left = Py_MAX(left, (Py_ssize_t)floor(k - i * s / n + sd));
+    *sample_right = Py_MIN(right, (Py_ssize_t)floor(k + (n - i) * s / n + sd));
+}
+
+/*
+   In‐place Floyd-Rivest selection. Each step selects k within a small sample
+   window first and then partitions the whole range around the result, which
+   lands next to k with high probability. That takes about n + min(k, n - k)
+   comparisons on average, against roughly 3.4n for random pivots, which
+   matters when comparisons are rich compares between Python objects.
+   Short ranges, and ranges that fail to shrink within the usual iteration
+   limit, are finished by quickselect_inplace().
+   Returns 0 on success or -1 if a comparison raised.
+*/
+static int
+floydrivest_inplace(PyObject **items, PyObject **keys,
+                    Py_ssize_t left, Py_ssize_t right, Py_ssize_t k,
+                    SelectState *st)
+{
+    int iterations = 0;
+    long max_iter = quickselect_max_iter(right - left + 1);
+
+    while (right - left > FLOYD_RIVEST_CUTOFF && iterations++ < max_iter) {
+        Py_ssize_t sample_left, sample_right, pos;
+        floyd_rivest_sample(left, right, k, &sample_left, &sample_right);
+        if (floydrivest_inplace(items, keys, sample_left, sample_right, k, st) < 0)
+            return -1;
+        swap_items(items, k, left, keys);
+        if (block_partition(items, keys, left, right, &pos, st) < 0)
+            return -1;
+        if (pos == k)
+            return 0;
+        else if (k < pos)
+            right = pos - 1;
+        else
+            left = pos + 1;
+    }
+    return quickselect_inplace(items, keys, left, right, k, st);
+}
+
+/* ---------- multiple ranks ---------- */
+
+/*
+   Move the largest item of [left, k] to index k in one linear scan.
+   Returns 0 on success or -1 if a comparison raised.
+*/
+static int
+move_max_to(PyObject **items, PyObject **keys, Py_ssize_t left, Py_ssize_t k,
+            SelectState *st)
+{
+    Py_ssize_t max = k;
+    for (Py_ssize_t i = left; i < k; i++) {
+        int cmp = less_than(keys ? keys[max] : items[max],
+                            keys ? keys[i] : items[i], st);
+        if (cmp < 0)
+            return -1;
+        if (cmp)
+            max = i;
+    }
+    swap_items(items, max, k, keys);
+    return 0;
+}
+
+/*
+   In‐place multi-quickselect: puts every index in the sorted array ks[0..nks)
+   (all within [left, right]) into its final sorted position. Each partition
+   step serves all the indices on either side of its pivot, so m indices take
+   O(n log m) comparisons instead of the O(n m) of separate selections.
+   Like quickselect_inplace(), it switches to median-of-medians pivots after
+   too many steps, and it hands the last index of a range to
+   floydrivest_inplace() or quickselect_inplace(). Two adjacent indices, such
+   as the middle pair of an even count, cost a single selection: once the
+   upper one is placed, the lower one is the largest item before it.
+   Returns 0 on success or -1 if a comparison raised.
+*/
+static int
+multiselect_inplace(PyObject **items, PyObject **keys,
+                    Py_ssize_t left, Py_ssize_t right,
+                    const Py_ssize_t *ks, Py_ssize_t nks, SelectState *st)
+{
+    int iterations = 0;
+    long max_iter = quickselect_max_iter(right - left + 1);
+
+    while (nks > 1 && left < right) {
+        if (nks == 2 && ks[1] == ks[0] + 1) {
+            if (multiselect_inplace(items, keys, left, right, ks + 1, 1, st) < 0)
+                return -1;
+            return move_max_to(items, keys, left, ks[0], st);
+        }
+        Py_ssize_t pivot_index;
+        Py_ssize_t pos;
+        if (iterations < max_iter) {
+            iterations++;
+            pivot_index = random_index(left, right);
+        }
+        else if (median_of_medians(items, keys, left, right, &pivot_index, st) < 0) {
+            return -1;
+        }
+        swap_items(items, pivot_index, left, keys);
+        if (block_partition(items, keys, left, right, &pos, st) < 0)
+            return -1;
+
+        /* ks[0..below) lie left of the pivot and ks[above..nks) right of it. */
+        Py_ssize_t below = 0;
+        while (below < nks && ks[below] < pos)
+            below++;
+        Py_ssize_t above = below;
+        if (above < nks && ks[above] == pos)
+            above++;
+        if (multiselect_inplace(items, keys, left, pos - 1, ks, below, st) < 0)
+            return -1;
+        ks += above;
+        nks -= above;
+        left = pos + 1;
+    }
+    if (nks == 1 && left < right) {
+        if (right - left + 1 >= FLOYD_RIVEST_MIN_SIZE)
+            return floydrivest_inplace(items, keys, left, right, ks[0], st);
+        return quickselect_inplace(items, keys, left, right, ks[0], st);
+    }
+    return 0;
+}
+
+/* ---------- typed selection engine ---------- */
+
+/* Selection strategies, as chosen by the public functions.
+   SELECT_PARTIAL_SORT selects like SELECT_NTH and then sorts the items
+   before the index as well. */
+enum {
+    SELECT_QUICK,
+    SELECT_HEAP,
+    SELECT_FLOYD_RIVEST,
+    SELECT_NTH,
+    SELECT_PARTIAL_SORT
+};
+
+/* The strategy nth_element uses for index k of n items. */
+static int
+nth_element_method(Py_ssize_t n, Py_ssize_t k)
+{
+    if (k < (n >> 4))
+        return SELECT_HEAP;
+    if (n >= FLOYD_RIVEST_MIN_SIZE)
+        return SELECT_FLOYD_RIVEST;
+    return SELECT_QUICK;
+}
+
+/*
+   DEFINE_TYPED_SELECT(NAME, TYPE, LT) expands to selection routines over a
+   plain C array of TYPE, ordered by the macro LT(a, b).
+   No Python code runs inside them, so they cannot fail:
+     • NAME_quickselect() uses a Hoare partition (NAME_partition()) around a
+       random pivot and, like quickselect_inplace(), switches to
+       median-of-medians pivots (NAME_median_of_medians()) once it exceeds
+       its iteration limit.
+     • NAME_floydrivest() is the counterpart of floydrivest_inplace().
+     • NAME_multiselect() is the counterpart of multiselect_inplace(),
+       including its single-selection shortcut for two adjacent indices.
+     • NAME_heapselect() keeps a max-heap of the k+1 smallest items in
+       v[0..k] and finally moves its root to v[k].
+     • NAME_partial_sort() selects v[k] as nth_element would and then
+       heapsorts v[0..k).
+   All leave v[k] in its sorted position, smaller items before it and
+   larger items after it.
+*/
+#define DEFINE_TYPED_SELECT(NAME, TYPE, LT)                                   \
+static void                                                                  \
+NAME##_quickselect(TYPE *v, Py_ssize_t left, Py_ssize_t right, Py_ssize_t k); \
+                                                                             \
+static void                                                                  \
+NAME##_insertion_sort(TYPE *v, Py_ssize_t left, Py_ssize_t right)            \
+{                                                                            \
+    for (Py_ssize_t i = left + 1; i <= right; i++) {                         \
+        TYPE item = v[i];                                                    \
+        Py_ssize_t j = i;                                                    \
+        for (; j > left && LT(item, v[j - 1]); j--)                          \
+            v[j] = v[j - 1];                                                 \
+        v[j] = item;                                                         \
+    }                                                                        \
+}                                                                            \
+                                                                             \
+static Py_ssize_t                                                            \
+NAME##_median_of_medians(TYPE *v, Py_ssize_t left, Py_ssize_t right)         \
+{                                                                            \
+    Py_ssize_t n = right - left + 1, m = 0;                                  \
+    TYPE tmp;                                                                \
+                                                                             \
+    if (n < 5) {                                                             \
+        NAME##_insertion_sort(v, left, right);                               \
+        return left + n / 2;                                                 \
+    }                                                                        \
+    for (Py_ssize_t g = left; g + 4 <= right; g += 5, m++) {                 \
+        NAME##_insertion_sort(v, g, g + 4);                                  \
+        tmp = v[left + m]; v[left + m] = v[g + 2]; v[g + 2] = tmp;           \
+    }                                                                        \
+    NAME##_quickselect(v, left, left + m - 1, left + m / 2);                 \
+    return left + m / 2;                                                     \
+}                                                                            \
+                                                                             \
+/* Partition [left, right] around the pivot at v[left]; return its new index. */ \
+static Py_ssize_t                                                            \
+NAME##_partition(TYPE *v, Py_ssize_t left, Py_ssize_t right)                 \
+{                                                                            \
+    TYPE pivot = v[left], tmp;                                               \
+    Py_ssize_t i = left + 1, j = right;                                      \
+    for (;;) {                                                               \
+        while (i <= j && LT(v[i], pivot))                                    \
+            i++;                                                             \
+        while (i <= j && LT(pivot, v[j]))                                    \
+            j--;                                                             \
+        if (i >= j)                                                          \
+            break;                                                           \
+        tmp = v[i]; v[i] = v[j]; v[j] = tmp;                                 \
+        i++; j--;                                                            \
+    }                                                                        \
+    /* v[left+1..j] <= pivot <= v[j+1..right]; put the pivot at j. */       \
+    v[left] = v[j]; v[j] = pivot;                                            \
+    return j;                                                                \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_quickselect(TYPE *v, Py_ssize_t left, Py_ssize_t right, Py_ssize_t k) \
+{                                                                            \
+    int iterations = 0;                                                      \
+    long max_iter = quickselect_max_iter(right - left + 1);                  \
+    TYPE tmp;                                                                \
+                                                                             \
+    while (left < right) {                                                   \
+        Py_ssize_t p;                                                        \
+        if (iterations < max_iter) {                                         \
+            iterations++;                                                    \
+            p = random_index(left, right);                                   \
+        }                                                                    \
+        else {                                                               \
+            p = NAME##_median_of_medians(v, left, right);                    \
+        }                                                                    \
+        tmp = v[left]; v[left] = v[p]; v[p] = tmp;                           \
+        Py_ssize_t j = NAME##_partition(v, left, right);                     \
+        if (j == k)                                                          \
+            return;                                                          \
+        else if (k < j)                                                      \
+            right = j - 1;                                                   \
+        else                                                                 \
+            left = j + 1;                                                    \
+    }                                                                        \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_floydrivest(TYPE *v, Py_ssize_t left, Py_ssize_t right, Py_ssize_t k) \
+{                                                                            \
+    int iterations = 0;                                                      \
+    long max_iter = quickselect_max_iter(right - left + 1);                  \
+    TYPE tmp;                                                                \
+                                                                             \
+    while (right - left > FLOYD_RIVEST_CUTOFF && iterations++ < max_iter) {  \
+        Py_ssize_t sample_left, sample_right;                                \
+        floyd_rivest_sample(left, right, k, &sample_left, &sample_right);    \
+        NAME##_floydrivest(v, sample_left, sample_right, k);                 \
+        tmp = v[left]; v[left] = v[k]; v[k] = tmp;                           \
+        Py_ssize_t j = NAME##_partition(v, left, right);                     \
+        if (j == k)                                                          \
+            return;                                                          \
+        else if (k < j)                                                      \
+            right = j - 1;                                                   \
+        else                                                                 \
+            left = j + 1;                                                    \
+    }                                                                        \
+    NAME##_quickselect(v, left, right, k);                                   \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_multiselect(TYPE *v, Py_ssize_t left, Py_ssize_t right,              \
+                   const Py_ssize_t *ks, Py_ssize_t nks)                     \
+{                                                                            \
+    int iterations = 0;                                                      \
+    long max_iter = quickselect_max_iter(right - left + 1);                  \
+    TYPE tmp;                                                                \
+                                                                             \
+    while (nks > 1 && left < right) {                                        \
+        Py_ssize_t p;                                                        \
+        if (nks == 2 && ks[1] == ks[0] + 1) {                                \
+            NAME##_floydrivest(v, left, right, ks[1]);                       \
+            p = ks[0];                                                       \
+            for (Py_ssize_t i = left; i < ks[0]; i++) {                      \
+                if (LT(v[p], v[i]))                                          \
+                    p = i;                                                   \
+            }                                                                \
+            tmp = v[ks[0]]; v[ks[0]] = v[p]; v[p] = tmp;                     \
+            return;                                                          \
+        }                                                                    \
+        if (iterations < max_iter) {                                         \
+            iterations++;                                                    \
+            p = random_index(left, right);                                   \
+        }                                                                    \
+        else {                                                               \
+            p = NAME##_median_of_medians(v, left, right);                    \
+        }                                                                    \
+        tmp = v[left]; v[left] = v[p]; v[p] = tmp;                           \
+        Py_ssize_t j = NAME##_partition(v, left, right);                     \
+        Py_ssize_t below = 0;                                                \
+        while (below < nks && ks[below] < j)                                 \
+            below++;                                                         \
+        Py_ssize_t above = below;                                            \
+        if (above < nks && ks[above] == j)                                   \
+            above++;                                                         \
+        NAME##_multiselect(v, left, j - 1, ks, below);                       \
+        ks += above;                                                         \
+        nks -= above;                                                        \
+        left = j + 1;                                                        \
+    }                                                                        \
+    if (nks == 1 && left < right)                                            \
+        NAME##_floydrivest(v, left, right, ks[0]);                           \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_sift_down(TYPE *v, Py_ssize_t size, Py_ssize_t i)                     \
+{                                                                            \
+    TYPE item = v[i];                                                        \
+    for (;;) {                                                               \
+        Py_ssize_t child = 2 * i + 1;                                        \
+        if (child >= size)                                                   \
+            break;                                                           \
+        if (child + 1 < size && LT(v[child], v[child + 1]))                  \
+            child++;                                                         \
+        if (!LT(item, v[child]))                                             \
+            break;                                                           \
+        v[i] = v[child];                                                     \
+        i = child;                                                           \
+    }                                                                        \
+    v[i] = item;                                                             \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_heapselect(TYPE *v, Py_ssize_t n, Py_ssize_t k)                       \
+{                                                                            \
+    Py_ssize_t size = k + 1;                                                 \
+    TYPE tmp;                                                                \
+                                                                             \
+    for (Py_ssize_t i = (size / 2) - 1; i >= 0; i--)                         \
+        NAME##_sift_down(v, size, i);                                        \
+    for (Py_ssize_t i = size; i < n; i++) {                                  \
+        if (LT(v[i], v[0])) {                                                \
+            tmp = v[0]; v[0] = v[i]; v[i] = tmp;                             \
+            NAME##_sift_down(v, size, 0);                                    \
+        }                                                                    \
+    }                                                                        \
+    tmp = v[0]; v[0] = v[k]; v[k] = tmp;                                     \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_partial_sort(TYPE *v, Py_ssize_t n, Py_ssize_t k)                     \
+{                                                                            \
+    TYPE tmp;                                                                \
+                                                                             \
+    switch (nth_element_method(n, k)) {                                      \
+    case SELECT_HEAP:                                                        \
+        NAME##_heapselect(v, n, k);                                          \
+        break;                                                               \
+    case SELECT_FLOYD_RIVEST:                                                \
+        NAME##_floydrivest(v, 0, n - 1, k);                                  \
+        break;                                                               \
+    default:                                                                 \
+        NAME##_quickselect(v, 0, n - 1, k);                                  \
+    }                                                                        \
+    for (Py_ssize_t i = (k / 2) - 1; i >= 0; i--)                            \
+        NAME##_sift_down(v, k, i);                                           \
+    for (Py_ssize_t end = k - 1; end > 0; end--) {                           \
+        tmp = v[0]; v[0] = v[end]; v[end] = tmp;                             \
+        NAME##_sift_down(v, end, 0);                                         \
+    }                                                                        \
+}
+
+/* ---------- float fast path ---------- */
+
+/* A list item paired with the double value of its key. */
+typedef struct {
+    double key;
+    PyObject *value;
+} FloatItem;
+
+#define FLOATITEM_LT(a, b) ((a).key < (b).key)
+
+DEFINE_TYPED_SELECT(floatitem, FloatItem, FLOATITEM_LT)
+
+/*
+   Selection for lists whose keys are all exact floats (detected by
+   select_state_init). The doubles are extracted once into a contiguous
+   FloatItem array, selection of the nks sorted indices ks runs on the raw
+   doubles (with the given SELECT_QUICK/SELECT_HEAP/SELECT_FLOYD_RIVEST
+   strategy or SELECT_PARTIAL_SORT for a single index), and the item array is
+   then rewritten in the resulting order. Rewriting only permutes the list's
+   own references, so no reference counts change. With reverse set, the
+   doubles are negated, which orders them from largest to smallest.
+   Returns 0 on success or -1 (with MemoryError set) on failure.
+*/
+static int
+float_select(PyObject **items, PyObject **keys, Py_ssize_t n,
+             const Py_ssize_t *ks, Py_ssize_t nks, int method, int reverse)
+{
+    FloatItem *pairs = PyMem_New(FloatItem, n);
+    if (pairs == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < n; i++) {
+        pairs[i].value = items[i];
+        pairs[i].key = PyFloat_AS_DOUBLE(keys ? keys[i] : items[i]);
+        if (reverse)
+            pairs[i].key = -pairs[i].key;
+    }
+
+    if (nks > 1)
+        floatitem_multiselect(pairs, 0, n - 1, ks, nks);
+    else if (method == SELECT_PARTIAL_SORT)
+        floatitem_partial_sort(pairs, n, ks[0]);
+    else if (method == SELECT_HEAP)
+        floatitem_heapselect(pairs, n, ks[0]);
+    else if (method == SELECT_FLOYD_RIVEST)
+        floatitem_floydrivest(pairs, 0, n - 1, ks[0]);
+    else
+        floatitem_quickselect(pairs, 0, n - 1, ks[0]);
+
+    for (Py_ssize_t i = 0; i < n; i++)
+        items[i] = pairs[i].value;
+    PyMem_Free(pairs);
+    return 0;
+}
+
+/* ---------- parallel partitioning for numeric buffers ---------- */
+
+/*
+   A small pool of native helper threads, started with the GIL held and then
+   driven without it. pool_run() runs task(arg, t) on every thread t, with t == 0
+   being the calling thread, and returns once all of them have finished.
+   Each helper waits on its own start lock and signals its own done lock.
+*/
+typedef struct WorkerPool WorkerPool;
+
+typedef struct {
+    WorkerPool *pool;
+    int index;
+} WorkerSlot;
+
+struct WorkerPool {
+    int nthreads;
+    int quit;
+    void (*task)(void *, int);
+    void *arg;
+    PyThread_type_lock *start;
+    PyThread_type_lock *done;
+    WorkerSlot *slots;
+};
+
+static void
+pool_worker(void *arg)
+{
+    WorkerSlot *slot = (WorkerSlot *)arg;
+    WorkerPool *pool = slot->pool;
+    int t = slot->index;
+
+    for (;;) {
+        PyThread_acquire_lock(pool->start[t], WAIT_LOCK);
+        if (pool->quit) {
+            PyThread_release_lock(pool->done[t]);
+            return;
+        }
+        pool->task(pool->arg, t);
+        PyThread_release_lock(pool->done[t]);
+    }
+}
+
+static void
+pool_run(WorkerPool *pool, void (*task)(void *, int), void *arg)
+{
+    pool->task = task;
+    pool->arg = arg;
+    for (int t = 1; t < pool->nthreads; t++)
+        PyThread_release_lock(pool->start[t]);
+    task(arg, 0);
+    for (int t = 1; t < pool->nthreads; t++)
+        PyThread_acquire_lock(pool->done[t], WAIT_LOCK);
+}
+
+/* Stop the helper threads and free the pool. Does not need the GIL. */
+static void
+pool_free(WorkerPool *pool)
+{
+    pool->quit = 1;
+    for (int t = 1; t < pool->nthreads; t++) {
+        PyThread_release_lock(pool->start[t]);
+        PyThread_acquire_lock(pool->done[t], WAIT_LOCK);
+    }
+    for (int t = 1; t < pool->nthreads; t++) {
+        PyThread_free_lock(pool->start[t]);
+        PyThread_free_lock(pool->done[t]);
+    }
+    PyMem_RawFree(pool->start);
+    PyMem_RawFree(pool->done);
+    PyMem_RawFree(pool->slots);
+    PyMem_RawFree(pool);
+}
+
+/*
+   Start up to nthreads - 1 helper threads. If the system refuses to start
+   some of them, the pool simply runs with fewer threads.
+   Returns NULL with MemoryError set on allocation failure.
+*/
+static WorkerPool *
+pool_new(int nthreads)
+{
+    WorkerPool *pool = PyMem_RawCalloc(1, sizeof(WorkerPool));
+    if (pool == NULL)
+        return (WorkerPool *)PyErr_NoMemory();
+    pool->start = PyMem_RawCalloc(nthreads, sizeof(PyThread_type_lock));
+    pool->done = PyMem_RawCalloc(nthreads, sizeof(PyThread_type_lock));
+    pool->slots = PyMem_RawCalloc(nthreads, sizeof(WorkerSlot));
+    pool->nthreads = 1;
+    if (pool->start == NULL || pool->done == NULL || pool->slots == NULL) {
+        pool_free(pool);
+        return (WorkerPool *)PyErr_NoMemory();
+    }
+
+    for (int t = 1; t < nthreads; t++) {
+        PyThread_type_lock start = PyThread_allocate_lock();
+        PyThread_type_lock done = PyThread_allocate_lock();
+        if (start == NULL || done == NULL) {
+            if (start != NULL)
+                PyThread_free_lock(start);
+            if (done != NULL)
+                PyThread_free_lock(done);
+            break;
+        }
+        /* Both locks start out held: the helper blocks on start, and
+           pool_run() blocks on done until the helper releases it. */
+        PyThread_acquire_lock(start, WAIT_LOCK);
+        PyThread_acquire_lock(done, WAIT_LOCK);
+        pool->start[t] = start;
+        pool->done[t] = done;
+        pool->slots[t].pool = pool;
+        pool->slots[t].index = t;
+        if (PyThread_start_new_thread(pool_worker, &pool->slots[t]) ==
+            PYTHREAD_INVALID_THREAD_ID) {
+            PyThread_free_lock(start);
+            PyThread_free_lock(done);
+            break;
+        }
+        pool->nthreads = t + 1;
+    }
+    return pool;
+}
+
+/* Predicates for one parallel partition step. */
+enum {
+    PARTITION_LT,   /* v[i] < pivot */
+    PARTITION_LE    /* !(pivot < v[i]) */
+};
+
+/*
+   Bookkeeping for partitioning v[left, left + size) across nchunks threads.
+   Every thread first partitions its own chunk so that the items matching the
+   predicate come first, ending at split[t]. With m matching items overall,
+   the items that ended up on the wrong side of left + m form at most nchunks
+   runs on each side (a_* on the left, b_* on the right) of equal total length.
+   The threads then swap them pairwise, each taking an equal share.
+*/
+typedef struct {
+    void *v;
+    const void *pivot;
+    int mode;
+    Py_ssize_t left, size;
+    int nchunks;
+    Py_ssize_t *split;
+    Py_ssize_t *a_start, *a_len;
+    Py_ssize_t *b_start, *b_len;
+    int na, nb;
+    Py_ssize_t misplaced;
+} ParallelPartition;
+
+/* Split total items into nchunks near-equal shares; return where share t starts. */
+static Py_ssize_t
+share_start(Py_ssize_t total, int nchunks, int t)
+{
+    return (total / nchunks) * t + Py_MIN(t, total % nchunks);
+}
+
+static Py_ssize_t
+chunk_start(const ParallelPartition *pp, int t)
+{
+    return pp->left + share_start(pp->size, pp->nchunks, t);
+}
+
+/* Allocate the per-chunk arrays of pp. Returns -1 with MemoryError set on failure. */
+static int
+parallel_partition_init(ParallelPartition *pp, int nchunks)
+{
+    Py_ssize_t *mem = PyMem_RawMalloc(5 * nchunks * sizeof(Py_ssize_t));
+    if (mem == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    pp->nchunks = nchunks;
+    pp->split = mem;
+    pp->a_start = mem + nchunks;
+    pp->a_len = mem + 2 * nchunks;
+    pp->b_start = mem + 3 * nchunks;
+    pp->b_len = mem + 4 * nchunks;
+    return 0;
+}
+
+/* Find the r-th position across a list of runs. */
+static void
+runs_seek(const Py_ssize_t *start, const Py_ssize_t *len, Py_ssize_t r,
+          int *run, Py_ssize_t *pos)
+{
+    int i = 0;
+    while (r >= len[i]) {
+        r -= len[i];
+        i++;
+    }
+    *run = i;
+    *pos = start[i] + r;
+}
+
+/* Advance to the next position across a list of (non-empty) runs. */
+static void
+runs_next(const Py_ssize_t *start, const Py_ssize_t *len, int *run, Py_ssize_t *pos)
+{
+    (*pos)++;
+    if (*pos == start[*run] + len[*run]) {
+        (*run)++;
+        *pos = start[*run];
+    }
+}
+
+/*
+   Partition pp's range with the given per-type chunk and swap tasks.
+   Returns the number of items matching the predicate; they now occupy
+   v[left, left + m).
+*/
+static Py_ssize_t
+parallel_partition(WorkerPool *pool, ParallelPartition *pp,
+                   void (*chunk_task)(void *, int),
+                   void (*swap_task)(void *, int))
+{
+    pool_run(pool, chunk_task, pp);
+
+    Py_ssize_t m = 0;
+    for (int t = 0; t < pp->nchunks; t++)
+        m += pp->split[t] - chunk_start(pp, t);
+    Py_ssize_t mid = pp->left + m;
+
+    pp->na = pp->nb = 0;
+    pp->misplaced = 0;
+    for (int t = 0; t < pp->nchunks; t++) {
+        Py_ssize_t s = chunk_start(pp, t);
+        Py_ssize_t e = chunk_start(pp, t + 1);
+        Py_ssize_t lo = Py_MAX(pp->split[t], s), hi = Py_MIN(e, mid);
+        if (lo < hi) {
+            pp->a_start[pp->na] = lo;
+            pp->a_len[pp->na++] = hi - lo;
+            pp->misplaced += hi - lo;
+        }
+        lo = Py_MAX(s, mid);
+        hi = pp->split[t];
+        if (lo < hi) {
+            pp->b_start[pp->nb] = lo;
+            pp->b_len[pp->nb++] = hi - lo;
+        }
+    }
+    if (pp->misplaced > 0)
+        pool_run(pool, swap_task, pp);
+    return m;
+}
+
+/* Below this many items the remaining range is finished serially. */
+#ifndef PARALLEL_MIN_SIZE
+#define PARALLEL_MIN_SIZE 131072
+#endif
+
+/* The threads argument is capped so that each thread starts with at least
+   PARALLEL_CHUNK_MIN items, and at PARALLEL_MAX_THREADS threads in all:
+   beyond that, starting the threads costs more than they save. */
+#ifndef PARALLEL_CHUNK_MIN
+#define PARALLEL_CHUNK_MIN 65536
+#endif
+#ifndef PARALLEL_MAX_THREADS
+#define PARALLEL_MAX_THREADS 64
+#endif
+
+/*
+   DEFINE_PARALLEL_SELECT(NAME, TYPE, LT) expands to NAME_parallel_select(),
+   which narrows the range around k with parallel partition steps and then
+   finishes with the serial NAME_quickselect() from DEFINE_TYPED_SELECT. Runs without the GIL.
+*/
+#define DEFINE_PARALLEL_SELECT(NAME, TYPE, LT)                                \
+static void                                                                  \
+NAME##_chunk_task(void *arg, int t)                                          \
+{                                                                            \
+    ParallelPartition *pp = (ParallelPartition *)arg;                        \
+    TYPE *v = (TYPE *)pp->v;                                                 \
+    TYPE pivot = *(const TYPE *)pp->pivot;                                   \
+    Py_ssize_t i = chunk_start(pp, t), j = chunk_start(pp, t + 1) - 1;       \
+    TYPE tmp;                                                                \
+                                                                             \
+    for (;;) {                                                               \
+        if (pp->mode == PARTITION_LT) {                                      \
+            while (i <= j && LT(v[i], pivot))                                \
+                i++;                                                         \
+            while (i <= j && !LT(v[j], pivot))                               \
+                j--;                                                         \
+        }                                                                    \
+        else {                                                               \
+            while (i <= j && !LT(pivot, v[i]))                               \
+                i++;                                                         \
+            while (i <= j && LT(pivot, v[j]))                                \
+                j--;                                                         \
+        }                                                                    \
+        if (i >= j)                                                          \
+            break;                                                           \
+        tmp = v[i]; v[i] = v[j]; v[j] = tmp;                                 \
+        i++; j--;                                                            \
+    }                                                                        \
+    pp->split[t] = i;                                                        \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_swap_task(void *arg, int t)                                           \
+{                                                                            \
+    ParallelPartition *pp = (ParallelPartition *)arg;                        \
+    TYPE *v = (TYPE *)pp->v;                                                 \
+    Py_ssize_t r0 = share_start(pp->misplaced, pp->nchunks, t);              \
+    Py_ssize_t r1 = share_start(pp->misplaced, pp->nchunks, t + 1);          \
+    int ra, rb;                                                              \
+    Py_ssize_t a, b;                                                         \
+    TYPE tmp;                                                                \
+                                                                             \
+    if (r0 >= r1)                                                            \
+        return;                                                              \
+    runs_seek(pp->a_start, pp->a_len, r0, &ra, &a);                          \
+    runs_seek(pp->b_start, pp->b_len, r0, &rb, &b);                          \
+    for (Py_ssize_t r = r0; ; ) {                                            \
+        tmp = v[a]; v[a] = v[b]; v[b] = tmp;                                 \
+        if (++r == r1)                                                       \
+            break;                                                           \
+        runs_next(pp->a_start, pp->a_len, &ra, &a);                          \
+        runs_next(pp->b_start, pp->b_len, &rb, &b);                          \
+    }                                                                        \
+}                                                                            \
+                                                                             \
+static void                                                                  \
+NAME##_parallel_select(TYPE *v, Py_ssize_t n, Py_ssize_t k,                  \
+                       WorkerPool *pool, ParallelPartition *pp)              \
+{                                                                            \
+    Py_ssize_t left = 0, right = n - 1;                                      \
+    TYPE pivot, tmp;                                                         \
+                                                                             \
+    pp->v = v;                                                               \
+    pp->pivot = &pivot;                                                      \
+    while (right - left + 1 > PARALLEL_MIN_SIZE) {                           \
+        /* Median of three random samples: max(a, min(b, c)) with a <= b. */ \
+        TYPE a = v[random_index(left, right)];                               \
+        TYPE b = v[random_index(left, right)];                               \
+        TYPE c = v[random_index(left, right)];                               \
+        if (LT(b, a)) {                                                      \
+            tmp = a; a = b; b = tmp;                                         \
+        }                                                                    \
+        if (LT(c, b))                                                        \
+            b = c;                                                           \
+        pivot = LT(b, a) ? a : b;                                            \
+                                                                             \
+        pp->left = left;                                                     \
+        pp->size = right - left + 1;                                         \
+        pp->mode = PARTITION_LT;                                             \
+        Py_ssize_t m = parallel_partition(pool, pp, NAME##_chunk_task,       \
+                                          NAME##_swap_task);                 \
+        if (k < left + m) {                                                  \
+            right = left + m - 1;                                            \
+            continue;                                                        \
+        }                                                                    \
+        if (m == 0) {                                                        \
+            /* The pivot is the range minimum: split off its copies. */      \
+            pp->mode = PARTITION_LE;                                         \
+            m = parallel_partition(pool, pp, NAME##_chunk_task,              \
+                                   NAME##_swap_task);                        \
+            if (k < left + m)                                                \
+                return;                                                      \
+        }                                                                    \
+        left += m;                                                           \
+    }                                                                        \
+    NAME##_quickselect(v, left, right, k);                                   \
+}
+
+/* ---------- buffer fast path ---------- */
+
+/* The NAME_desc variants select in descending order, for reverse=True. */
+#define NUMBER_LT(a, b) ((a) < (b))
+#define NUMBER_GT(a, b) ((a) > (b))
+
+DEFINE_TYPED_SELECT(int8, int8_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(int8_desc, int8_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(uint8, uint8_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(uint8_desc, uint8_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(int16, int16_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(int16_desc, int16_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(uint16, uint16_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(uint16_desc, uint16_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(int32, int32_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(int32_desc, int32_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(uint32, uint32_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(uint32_desc, uint32_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(int64, int64_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(int64_desc, int64_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(uint64, uint64_t, NUMBER_LT)
+DEFINE_TYPED_SELECT(uint64_desc, uint64_t, NUMBER_GT)
+DEFINE_TYPED_SELECT(float32, float, NUMBER_LT)
+DEFINE_TYPED_SELECT(float32_desc, float, NUMBER_GT)
+DEFINE_TYPED_SELECT(float64, double, NUMBER_LT)
+DEFINE_TYPED_SELECT(float64_desc, double, NUMBER_GT)
+
+DEFINE_PARALLEL_SELECT(int8, int8_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(int8_desc, int8_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(uint8, uint8_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(uint8_desc, uint8_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(int16, int16_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(int16_desc, int16_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(uint16, uint16_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(uint16_desc, uint16_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(int32, int32_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(int32_desc, int32_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(uint32, uint32_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(uint32_desc, uint32_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(int64, int64_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(int64_desc, int64_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(uint64, uint64_t, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(uint64_desc, uint64_t, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(float32, float, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(float32_desc, float, NUMBER_GT)
+DEFINE_PARALLEL_SELECT(float64, double, NUMBER_LT)
+DEFINE_PARALLEL_SELECT(float64_desc, double, NUMBER_GT)
+
+/* C element types of the buffers that can be selected on directly. */
+typedef enum {
+    BUFFER_UNSUPPORTED,
+    BUFFER_INT8,
+    BUFFER_UINT8,
+    BUFFER_INT16,
+    BUFFER_UINT16,
+    BUFFER_INT32,
+    BUFFER_UINT32,
+    BUFFER_INT64,
+    BUFFER_UINT64,
+    BUFFER_FLOAT32,
+    BUFFER_FLOAT64
+} BufferKind;
+
+/*
+   Map a struct-module format string with a single numeric code
+   (b/B/h/H/i/I/l/L/q/Q/n/N/f/d) to the matching C element type. The item
+   size comes from the buffer itself, so standard-size formats such as "<l"
+   work too. Byte orders other than the native one are not supported.
+*/
+static BufferKind
+buffer_kind(const char *format, Py_ssize_t itemsize)
+{
+    const int one = 1;
+    const int little_endian = *(const char *)&one;
+
+    if (format == NULL)
+        format = "B";
+    switch (format[0]) {
+    case '@': case '=':
+        format++;
+        break;
+    case '<':
+        if (!little_endian)
+            return BUFFER_UNSUPPORTED;
+        format++;
+        break;
+    case '>': case '!':
+        if (little_endian)
+            return BUFFER_UNSUPPORTED;
+        format++;
+        break;
+    }
+    if (format[0] == '\0' || format[1] != '\0')
+        return BUFFER_UNSUPPORTED;
+
+    switch (format[0]) {
+    case 'b': case 'h': case 'i': case 'l': case 'q': case 'n':
+        switch (itemsize) {
+        case 1: return BUFFER_INT8;
+        case 2: return BUFFER_INT16;
+        case 4: return BUFFER_INT32;
+        case 8: return BUFFER_INT64;
+        }
+        break;
+    case 'B': case 'H': case 'I': case 'L': case 'Q': case 'N':
+        switch (itemsize) {
+        case 1: return BUFFER_UINT8;
+        case 2: return BUFFER_UINT16;
+        case 4: return BUFFER_UINT32;
+        case 8: return BUFFER_UINT64;
+        }
+        break;
+    case 'f':
+        if (itemsize == sizeof(float))
+            return BUFFER_FLOAT32;
+        break;
+    case 'd':
+        if (itemsize == sizeof(double))
+            return BUFFER_FLOAT64;
+        break;
+    }
+    return BUFFER_UNSUPPORTED;
+}
+
+/*
+   Get a one-dimensional, C-contiguous view of a numeric buffer, writable if
+   requested, and its element type.
+   Returns 0 on success or -1 with an exception set (and no view held).
+*/
+static int
+get_numeric_buffer(PyObject *values, Py_buffer *view, int writable, BufferKind *kind)
+{
+    if (PyObject_GetBuffer(values, view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) < 0)
+        return -1;
+    if (writable && view->readonly) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_TypeError, "values buffer must be writable");
+        return -1;
+    }
+    if (view->ndim != 1) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError, "values buffer must be one-dimensional");
+        return -1;
+    }
+    *kind = buffer_kind(view->format, view->itemsize);
+    if (*kind == BUFFER_UNSUPPORTED) {
+        PyErr_Format(PyExc_TypeError, "unsupported buffer format '%s'",
+                     view->format ? view->format : "B");
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+#define BUFFER_SELECT_CALL(NAME)                                             \
+        if (nks > 1)                                                         \
+            NAME##_multiselect(v, 0, n - 1, ks, nks);                        \
+        else if (pool != NULL)                                               \
+            NAME##_parallel_select(v, n, ks[0], pool, &pp);                  \
+        else if (method == SELECT_PARTIAL_SORT)                              \
+            NAME##_partial_sort(v, n, ks[0]);                                \
+        else if (method == SELECT_HEAP)                                      \
+            NAME##_heapselect(v, n, ks[0]);                                  \
+        else if (method == SELECT_FLOYD_RIVEST)                              \
+            NAME##_floydrivest(v, 0, n - 1, ks[0]);                          \
+        else                                                                 \
+            NAME##_quickselect(v, 0, n - 1, ks[0]);
+
+#define BUFFER_SELECT_CASE(KIND, NAME, TYPE)                                 \
+    case KIND: {                                                             \
+        TYPE *v = (TYPE *)start;                                             \
+        if (reverse) {                                                       \
+            BUFFER_SELECT_CALL(NAME##_desc)                                  \
+        }                                                                    \
+        else {                                                               \
+            BUFFER_SELECT_CALL(NAME)                                         \
+        }                                                                    \
+        break;                                                               \
+    }
+
+/*
+   Select directly on the memory of a writable, one-dimensional, C-contiguous
+   buffer with a numeric format (array.array, memoryview, NumPy arrays, ...).
+   No Python objects are created and no key function is supported.
+   The GIL is released while partitioning; the buffer export we hold keeps
+   the exporter from resizing or freeing the memory meanwhile.
+   The nks indices in ks must be sorted; a single index is selected with the
+   given strategy, or partially sorted up to it with SELECT_PARTIAL_SORT.
+   As in list_select(), only items lo..hi-1 are selected on, with ks
+   relative to lo, and reverse selects in descending order.
+   With threads > 1, large quickselect/nth_element calls partition in
+   parallel on a pool of that many threads, capped as described at
+   PARALLEL_CHUNK_MIN.
+*/
+static PyObject *
+buffer_select(PyObject *values, const Py_ssize_t *ks, Py_ssize_t nks,
+              PyObject *key, int method, int threads, Py_ssize_t lo, Py_ssize_t hi,
+              int reverse)
+{
+    if (key != Py_None) {
+        PyErr_SetString(PyExc_TypeError, "key is not supported for buffer values");
+        return NULL;
+    }
+
+    Py_buffer view;
+    BufferKind kind;
+    if (get_numeric_buffer(values, &view, 1, &kind) < 0)
+        return NULL;
+
+    Py_ssize_t n = Py_MAX(0, Py_MIN(hi, view.shape[0]) - lo);
+    if (nks > 0 && (ks[0] < 0 || ks[nks - 1] >= n)) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+    if (nks == 0) {
+        PyBuffer_Release(&view);
+        Py_RETURN_NONE;
+    }
+    char *start = (char *)view.buf + lo * view.itemsize;
+
+    if (method == SELECT_NTH)
+        method = nth_element_method(n, ks[0]);
+    WorkerPool *pool = NULL;
+    ParallelPartition pp;
+    threads = (int)Py_MIN(Py_MIN(threads, PARALLEL_MAX_THREADS), n / PARALLEL_CHUNK_MIN);
+    if (threads > 1 && nks == 1 && method != SELECT_HEAP &&
+        method != SELECT_PARTIAL_SORT && n > PARALLEL_MIN_SIZE) {
+        pool = pool_new(threads);
+        if (pool == NULL) {
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+        if (parallel_partition_init(&pp, pool->nthreads) < 0) {
+            pool_free(pool);
+            PyBuffer_Release(&view);
+            return NULL;
+        }
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    switch (kind) {
+    BUFFER_SELECT_CASE(BUFFER_INT8, int8, int8_t)
+    BUFFER_SELECT_CASE(BUFFER_UINT8, uint8, uint8_t)
+    BUFFER_SELECT_CASE(BUFFER_INT16, int16, int16_t)
+    BUFFER_SELECT_CASE(BUFFER_UINT16, uint16, uint16_t)
+    BUFFER_SELECT_CASE(BUFFER_INT32, int32, int32_t)
+    BUFFER_SELECT_CASE(BUFFER_UINT32, uint32, uint32_t)
+    BUFFER_SELECT_CASE(BUFFER_INT64, int64, int64_t)
+    BUFFER_SELECT_CASE(BUFFER_UINT64, uint64, uint64_t)
+    BUFFER_SELECT_CASE(BUFFER_FLOAT32, float32, float)
+    BUFFER_SELECT_CASE(BUFFER_FLOAT64, float64, double)
+    default:
+        break;
+    }
+    if (pool != NULL) {
+        PyMem_RawFree(pp.split);
+        pool_free(pool);
+    }
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&view);
+    Py_RETURN_NONE;
+}
+
+#define BUFFER_VALUES_CASE(KIND, NAME, TYPE, TO_OBJECT)                       \
+    case KIND: {                                                             \
+        TYPE *v = (TYPE *)copy;                                              \
+        Py_BEGIN_ALLOW_THREADS                                               \
+        if (reverse)                                                         \
+            NAME##_desc_multiselect(v, 0, n - 1, ks, nks);                   \
+        else                                                                 \
+            NAME##_multiselect(v, 0, n - 1, ks, nks);                        \
+        Py_END_ALLOW_THREADS                                                 \
+        for (Py_ssize_t i = 0; i < nks; i++) {                               \
+            out[i] = TO_OBJECT(v[ks[i]]);                                    \
+            if (out[i] == NULL) {                                            \
+                while (--i >= 0)                                             \
+                    Py_DECREF(out[i]);                                       \
+                goto done;                                                   \
+            }                                                                \
+        }                                                                    \
+        ret = 0;                                                             \
+        break;                                                               \
+    }
+
+#define SIGNED_TO_OBJECT(x) PyLong_FromLongLong((long long)(x))
+#define UNSIGNED_TO_OBJECT(x) PyLong_FromUnsignedLongLong((unsigned long long)(x))
+#define FLOAT_TO_OBJECT(x) PyFloat_FromDouble((double)(x))
+
+/*
+   Find the values at the nks sorted indices ks of a numeric buffer (which may
+   be read-only) without changing it: the selection runs on a private copy of
+   its memory, without the GIL. New references to the values, as int or
+   float objects, are stored in out[0..nks). With reverse set, ks count
+   from the largest value.
+   Returns 0 on success or -1 with an exception set.
+*/
+static int
+buffer_select_values(PyObject *values, const Py_ssize_t *ks, Py_ssize_t nks,
+                     int reverse, PyObject **out)
+{
+    Py_buffer view;
+    BufferKind kind;
+    if (get_numeric_buffer(values, &view, 0, &kind) < 0)
+        return -1;
+
+    Py_ssize_t n = view.shape[0];
+    if (nks > 0 && (ks[0] < 0 || ks[nks - 1] >= n)) {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return -1;
+    }
+    if (nks == 0) {
+        PyBuffer_Release(&view);
+        return 0;
+    }
+
+    void *copy = PyMem_Malloc((size_t)view.len);
+    if (copy == NULL) {
+        PyBuffer_Release(&view);
+        PyErr_NoMemory();
+        return -1;
+    }
+    memcpy(copy, view.buf, (size_t)view.len);
+    PyBuffer_Release(&view);
+
+    int ret = -1;
+    switch (kind) {
+    BUFFER_VALUES_CASE(BUFFER_INT8, int8, int8_t, SIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_UINT8, uint8, uint8_t, UNSIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_INT16, int16, int16_t, SIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_UINT16, uint16, uint16_t, UNSIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_INT32, int32, int32_t, SIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_UINT32, uint32, uint32_t, UNSIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_INT64, int64, int64_t, SIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_UINT64, uint64, uint64_t, UNSIGNED_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_FLOAT32, float32, float, FLOAT_TO_OBJECT)
+    BUFFER_VALUES_CASE(BUFFER_FLOAT64, float64, double, FLOAT_TO_OBJECT)
+    default:
+        break;
+    }
+
+done:
+    PyMem_Free(copy);
+    return ret;
+}
+
+/* ---------- heapselect implementation ---------- */
+
+/* Structure to hold an element for the heap.
+   Each HeapItem contains a pointer to the list element (value) and
+   the corresponding key (if any; if not, key==value).
+*/
+typedef struct {
+    PyObject *value;
+    PyObject *key;
+} HeapItem;
+
+/* heapselect switches from a binary to a 4-ary heap for heaps of at least
+   this many items whose keys have a specialized comparison. Below about a
+   million items (16 MB of HeapItems) the binary heap was as fast or faster. */
+#ifndef HEAPSELECT_DARY_MIN_SIZE
+#define HEAPSELECT_DARY_MIN_SIZE (1 << 20)
+#endif
+
+/* Max-heap helper: Restore the max-heap property for heap[i] assuming
+   that the trees rooted at its children are valid. The children of heap[i]
+   are heap[arity*i+1 .. arity*i+arity].
+   This is Floyd's bottom-up sift-down, as in heapq's _siftup(): the largest
+   child is moved up level by level until a leaf is reached, with arity-1
+   comparisons per level, and heap[i]'s item then sifts back up from there.
+   A replaced root usually belongs near the bottom, so that second phase is
+   short, and this takes about half the comparisons of the textbook version.
+   Returns 0 on success or -1 if a comparison raised; the heap then still
+   holds the same items.
+*/
+static int
+max_heapify(HeapItem *heap, Py_ssize_t heap_size, Py_ssize_t i, int arity,
+            SelectState *st)
+{
+    HeapItem item = heap[i];
+    Py_ssize_t start = i;
+    Py_ssize_t child = arity * i + 1;
+    int cmp;
+
+    while (child < heap_size) {
+        Py_ssize_t end = Py_MIN(child + arity, heap_size);
+        Py_ssize_t largest = child;
+        for (Py_ssize_t c = child + 1; c < end; c++) {
+            cmp = less_than(heap[largest].key, heap[c].key, st);
+            if (cmp < 0)
+                goto error;
+            if (cmp)
+                largest = c;
+        }
+        heap[i] = heap[largest];
+        i = largest;
+        child = arity * i + 1;
+    }
+
+    while (i > start) {
+        Py_ssize_t parent = (i - 1) / arity;
+        cmp = less_than(heap[parent].key, item.key, st);
+        if (cmp < 0)
+            goto error;
+        if (!cmp)
+            break;
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = item;
+    return 0;
+
+error:
+    heap[i] = item;
+    return -1;
+}
+
+/* Build a max-heap from an array of HeapItem of size heap_size.
+   Returns 0 on success or -1 if a comparison raised.
+*/
+static int
+build_max_heap(HeapItem *heap, Py_ssize_t heap_size, int arity, SelectState *st)
+{
+    for (Py_ssize_t i = (heap_size - 2) / arity; i >= 0; i--) {
+        if (max_heapify(heap, heap_size, i, arity, st) < 0)
+            return -1;
+    }
+    return 0;
+}
+
+/*
+   Heap selection on a detached item array and its precomputed keys (or NULL).
+   We want the kth smallest element. Build a max-heap of the first (k+1) items
+   so that the heap’s root is the largest among them (and hence the kth
+   smallest overall so far). Then for each subsequent item, if its key is less
+   than the root, update the root and restore the heap. Finally partition the
+   items around the root's key.
+   Large heaps outgrow the CPU caches, and every level of a sift-down is then
+   likely a cache miss. When comparisons are cheap, a 4-ary heap with each
+   node's children in one 64-byte cache line does better: it has half the
+   levels for 3/2 the comparisons. With generic rich comparisons the extra
+   comparisons cost more than the misses, so those always use a binary heap.
+   Returns 0 on success or -1 on error.
+*/
+static int
+heapselect_inplace(PyObject **items, PyObject **keys, Py_ssize_t n, Py_ssize_t k,
+                   SelectState *st)
+{
+    Py_ssize_t heap_size = k + 1;
+    int arity = 2;
+    if (heap_size >= HEAPSELECT_DARY_MIN_SIZE &&
+        st->key_compare != safe_object_compare &&
+        st->key_compare != unsafe_object_compare &&
+        st->key_compare != unsafe_tuple_compare)
+        arity = 4;
+
+    /* Offset a 4-ary heap so that heap + 1, and with it each group of four
+       children heap[4i+1 .. 4i+4], starts on a 64-byte boundary. The padding
+       is counted in bytes, since PyMem_Malloc() may only align to 8. */
+    size_t padding = arity == 4 ? 63 + 3 * sizeof(HeapItem) : 0;
+    void *block = PyMem_Malloc((size_t)heap_size * sizeof(HeapItem) + padding);
+    if (block == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    HeapItem *heap = (HeapItem *)block;
+    if (arity == 4)
+        heap = (HeapItem *)(((uintptr_t)block + 63) & ~(uintptr_t)63) + 3;
+
+    for (Py_ssize_t i = 0; i < heap_size; i++) {
+        heap[i].value = items[i];
+        heap[i].key = keys ? keys[i] : items[i];
+    }
+    if (build_max_heap(heap, heap_size, arity, st) < 0) {
+        PyMem_Free(block);
+        return -1;
+    }
+
+    for (Py_ssize_t i = heap_size; i < n; i++) {
+        PyObject *current_key = keys ? keys[i] : items[i];
+        int cmp = less_than(current_key, heap[0].key, st);
+        if (cmp == 1) {  /* current < heap root */
+            heap[0].value = items[i];
+            heap[0].key = current_key;
+            cmp = max_heapify(heap, heap_size, 0, arity, st);
+        }
+        if (cmp < 0) {
+            PyMem_Free(block);
+            return -1;
+        }
+    }
+
+    /* The heap's root holds the pivot's key. Partition all items around it. */
+    PyObject *pivot_key = heap[0].key;
+    PyMem_Free(block);
+
+    Py_ssize_t low, mid;
+    if (partition_by_pivot(items, keys, n, pivot_key, &low, &mid, st) < 0)
+        return -1;
+    if (!(k >= low && k < mid)) {
+        PyErr_SetString(PyExc_RuntimeError, "heapselect partition failed to locate the target index");
+        return -1;
+    }
+    return 0;
+}
+
+/* merge_sort_range() sorts ranges of at most this many items by binary insertion. */
+#define SORT_RUN 32
+
+/*
+   Merge the sorted runs [lo, mid) and [mid, hi) of the items src and their
+   keys src_keys (or NULL) into dst and dst_keys, taking from the left run on
+   ties. Returns 0, or -1 if a comparison raised.
+*/
+static int
+merge_runs(PyObject **src, PyObject **src_keys, PyObject **dst, PyObject **dst_keys,
+           Py_ssize_t lo, Py_ssize_t mid, Py_ssize_t hi, SelectState *st)
+{
+    PyObject **kv = src_keys ? src_keys : src;
+    Py_ssize_t i = lo, j = mid, out = lo;
+    while (i < mid && j < hi) {
+        int cmp = less_than(kv[j], kv[i], st);
+        if (cmp < 0)
+            return -1;
+        Py_ssize_t from = cmp ? j++ : i++;
+        dst[out] = src[from];
+        if (dst_keys != NULL)
+            dst_keys[out] = src_keys[from];
+        out++;
+    }
+    memcpy(&dst[out], &src[i], (size_t)(mid - i) * sizeof(PyObject *));
+    memcpy(&dst[out + mid - i], &src[j], (size_t)(hi - j) * sizeof(PyObject *));
+    if (dst_keys != NULL) {
+        memcpy(&dst_keys[out], &src_keys[i], (size_t)(mid - i) * sizeof(PyObject *));
+        memcpy(&dst_keys[out + mid - i], &src_keys[j], (size_t)(hi - j) * sizeof(PyObject *));
+    }
+    return 0;
+}
+
+/* Sort [lo, hi) of the items and their keys (or NULL) by binary insertion. */
+static int
+binary_insertion_sort(PyObject **items, PyObject **keys, Py_ssize_t lo, Py_ssize_t hi,
+                      SelectState *st)
+{
+    PyObject **kv = keys ? keys : items;
+    for (Py_ssize_t i = lo + 1; i < hi; i++) {
+        /* Insert item i after the equal items of [lo, i). */
+        Py_ssize_t l = lo, r = i;
+        while (l < r) {
+            Py_ssize_t m = l + (r - l) / 2;
+            int cmp = less_than(kv[i], kv[m], st);
+            if (cmp < 0)
+                return -1;
+            if (cmp)
+                r = m;
+            else
+                l = m + 1;
+        }
+        PyObject *item = items[i];
+        memmove(&items[l + 1], &items[l], (size_t)(i - l) * sizeof(PyObject *));
+        items[l] = item;
+        if (keys != NULL) {
+            PyObject *item_key = keys[i];
+            memmove(&keys[l + 1], &keys[l], (size_t)(i - l) * sizeof(PyObject *));
+            keys[l] = item_key;
+        }
+    }
+    return 0;
+}
+
+/*
+   Merge sort [lo, hi) of the items and their keys (or NULL), using the
+   scratch arrays of the same size to merge into. Both halves are sorted
+   completely before they are merged, so small ranges are finished while
+   their items are still in the CPU caches.
+*/
+static int
+merge_sort_range(PyObject **items, PyObject **keys,
+                 PyObject **scratch, PyObject **scratch_keys,
+                 Py_ssize_t lo, Py_ssize_t hi, SelectState *st)
+{
+    if (hi - lo <= SORT_RUN)
+        return binary_insertion_sort(items, keys, lo, hi, st);
+    Py_ssize_t mid = lo + (hi - lo) / 2;
+    if (merge_sort_range(items, keys, scratch, scratch_keys, lo, mid, st) < 0 ||
+        merge_sort_range(items, keys, scratch, scratch_keys, mid, hi, st) < 0 ||
+        merge_runs(items, keys, scratch, scratch_keys, lo, mid, hi, st) < 0)
+        return -1;
+    memcpy(&items[lo], &scratch[lo], (size_t)(hi - lo) * sizeof(PyObject *));
+    if (keys != NULL)
+        memcpy(&keys[lo], &scratch_keys[lo], (size_t)(hi - lo) * sizeof(PyObject *));
+    return 0;
+}
+
+/*
+   Sort the first n items of a detached item array and its keys (or NULL)
+   with a merge sort that finishes runs of SORT_RUN items by binary
+   insertion. It needs about log2(n) comparisons per item, like the
+   timsort of list.sort() on unordered data, and reads and writes the
+   arrays sequentially.
+   Returns 0 on success or -1 on error; the items and keys are then still a
+   permutation of the originals.
+*/
+static int
+sort_items(PyObject **items, PyObject **keys, Py_ssize_t n, SelectState *st)
+{
+    if (n <= SORT_RUN)
+        return binary_insertion_sort(items, keys, 0, n, st);
+
+    PyObject **scratch = PyMem_New(PyObject *, keys ? 2 * n : n);
+    if (scratch == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    int ret = merge_sort_range(items, keys, scratch, keys ? scratch + n : NULL,
+                               0, n, st);
+    PyMem_Free(scratch);
+    return ret;
+}
+
+/* ---------- list selection ---------- */
+
+/*
+   Select the nks sorted indices ks on a detached item array, its precomputed
+   keys (or NULL) and the comparison chosen for them by select_state_init().
+   Several indices are selected together by multiselect_inplace(); a single
+   one uses the SELECT_QUICK/SELECT_HEAP/SELECT_FLOYD_RIVEST strategy given.
+   SELECT_PARTIAL_SORT selects the index with nth_element's strategy and
+   merge sorts the items before it.
+   Returns 0 on success or -1 on error.
+*/
+static int
+select_items(PyObject **items, PyObject **keys, Py_ssize_t n,
+             const Py_ssize_t *ks, Py_ssize_t nks, int method, SelectState *st)
+{
+    if (nks == 0)
+        return 0;
+    if (st->key_compare == unsafe_float_compare)
+        return float_select(items, keys, n, ks, nks, method, st->reverse);
+    if (method == SELECT_PARTIAL_SORT) {
+        if (ks[0] == n - 1)
+            return sort_items(items, keys, n, st);
+        if (select_items(items, keys, n, ks, 1, nth_element_method(n, ks[0]), st) < 0)
+            return -1;
+        return sort_items(items, keys, ks[0], st);
+    }
+    if (nks > 1)
+        return multiselect_inplace(items, keys, 0, n - 1, ks, nks, st);
+
+    Py_ssize_t k = ks[0];
+    switch (method) {
+    case SELECT_HEAP:
+        return heapselect_inplace(items, keys, n, k, st);
+    case SELECT_FLOYD_RIVEST:
+        return floydrivest_inplace(items, keys, 0, n - 1, k, st);
+    default:
+        return quickselect_inplace(items, keys, 0, n - 1, k, st);
+    }
+}
+
+/*
+   The list path shared by the public functions: check the arguments, detach
+   the list, call the key function once per item and select the nks sorted
+   indices ks (for a single index with the given strategy; SELECT_NTH picks
+   one from n and k). Every strategy works on the same keys array, so the
+   key function is never called twice for an item.
+   Only values[lo:hi] is selected on, with ks relative to lo; hi is clamped
+   to the length of the list like a slice end. With reverse set, the items
+   are ordered from largest to smallest.
+*/
+static PyObject *
+list_select(PyObject *values, const Py_ssize_t *ks, Py_ssize_t nks,
+            PyObject *key, int method, Py_ssize_t lo, Py_ssize_t hi, int reverse)
+{
+    Py_ssize_t n = Py_MAX(0, Py_MIN(hi, PyList_GET_SIZE(values)) - lo);
+    if (nks > 0 && (ks[0] < 0 || ks[nks - 1] >= n)) {
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+
+    if (key != Py_None && !PyCallable_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "key must be callable");
+        return NULL;
+    }
+
+    if (nks == 0)
+        Py_RETURN_NONE;
+    if (method == SELECT_NTH)
+        method = nth_element_method(n, ks[0]);
+
+    DetachedList detached;
+    PyObject **items = list_detach(&detached, values) + lo;
+    PyObject **keys = NULL;
+    if (key != Py_None) {
+        keys = compute_keys(key, items, n);
+        if (keys == NULL) {
+            list_reattach(&detached);
+            return NULL;
+        }
+    }
+
+    SelectState st;
+    select_state_init(&st, items, keys, n, reverse);
+
+    int ret = select_items(items, keys, n, ks, nks, method, &st);
+    free_objects(keys, n);
+    if (list_reattach(&detached) < 0 || ret < 0)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+/*
+   list_select() for the mutable sequences other than lists, such as
+   UserList: the items are read into a new list once, selected on there,
+   and then written back to values[lo:hi] with one slice assignment.
+   Sequences without slice assignment, such as collections.deque, are
+   written back item by item instead, which is quadratic for a deque.
+   Immutable sequences and other iterables raise TypeError, since they
+   cannot be partitioned in place.
+*/
+static PyObject *
+sequence_select(PyObject *values, const Py_ssize_t *ks, Py_ssize_t nks,
+                PyObject *key, int method, Py_ssize_t lo, Py_ssize_t hi, int reverse)
+{
+    PySequenceMethods *sq = Py_TYPE(values)->tp_as_sequence;
+    if (!PySequence_Check(values) || sq == NULL || sq->sq_ass_item == NULL) {
+        PyErr_SetString(PyExc_TypeError,
+                        "values must be a mutable sequence or a numeric buffer");
+        return NULL;
+    }
+    PyObject *list = PySequence_List(values);
+    if (list == NULL)
+        return NULL;
+    PyObject *result = list_select(list, ks, nks, key, method, lo, hi, reverse);
+    if (result != NULL) {
+        Py_ssize_t end = Py_MIN(hi, PyList_GET_SIZE(list));
+        PyObject *slice = PyList_GetSlice(list, lo, end);
+        int ret = slice != NULL ? PySequence_SetSlice(values, lo, end, slice) : -1;
+        if (ret < 0 && slice != NULL && PyErr_ExceptionMatches(PyExc_TypeError)) {
+            PyErr_Clear();
+            ret = 0;
+            for (Py_ssize_t i = lo; i < end && ret == 0; i++)
+                ret = PySequence_SetItem(values, i, PyList_GET_ITEM(list, i));
+        }
+        Py_XDECREF(slice);
+        if (ret < 0)
+            Py_CLEAR(result);
+    }
+    Py_DECREF(list);
+    return result;
+}
+
+/*
+   Find the values at the nks sorted indices ks of a list, tuple or numeric
+   buffer without reordering it, and store new references to them in
+   out[0..nks). This is the engine of the functions that return values
+   instead of partitioning in place. Lists and tuples are selected on a
+   scratch_copy() of their item pointers, ordered by key (or Py_None) and
+   from the largest value if reverse is set; buffers do not support a key.
+   Returns 0 on success or -1 with an exception set.
+*/
+static int
+select_values(PyObject *values, const Py_ssize_t *ks, Py_ssize_t nks,
+              PyObject *key, int reverse, PyObject **out)
+{
+    if (key != Py_None && !PyCallable_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "key must be callable");
+        return -1;
+    }
+    int is_list = PyList_Check(values);
+    if (!is_list && !PyTuple_Check(values)) {
+        if (key != Py_None) {
+            PyErr_SetString(PyExc_TypeError, "key is not supported for buffer values");
+            return -1;
+        }
+        return buffer_select_values(values, ks, nks, reverse, out);
+    }
+
+    Py_ssize_t n = Py_SIZE(values);
+    if (nks > 0 && (ks[0] < 0 || ks[nks - 1] >= n)) {
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return -1;
+    }
+    if (nks == 0)
+        return 0;
+
+    PyObject **keys = NULL;
+    int ret = -1;
+    PyObject **items = scratch_copy(PySequence_Fast_ITEMS(values), n, is_list);
+    if (items == NULL)
+        return -1;
+    if (key != Py_None) {
+        keys = compute_keys(key, items, n);
+        if (keys == NULL)
+            goto done;
+    }
+    SelectState st;
+    select_state_init(&st, items, keys, n, reverse);
+    ret = select_items(items, keys, n, ks, nks, nth_element_method(n, ks[0]), &st);
+    if (ret == 0) {
+        for (Py_ssize_t i = 0; i < nks; i++) {
+            out[i] = items[ks[i]];
+            Py_INCREF(out[i]);
+        }
+    }
+
+done:
+    free_objects(keys, n);
+    scratch_release(items, n, is_list);
+    return ret;
+}
+
+/* The array.array typecode of Py_ssize_t, used for index arrays. */
+#if SIZEOF_SIZE_T == SIZEOF_LONG
+#define INDEX_TYPECODE "l"
+#else
+#define INDEX_TYPECODE "q"
+#endif
+
+/*
+   A new array.array of the n indices stored in the item pointers of
+   indices by list_argselect().
+*/
+static PyObject *
+index_array(PyObject **indices, Py_ssize_t n)
+{
+    PyObject *data = PyBytes_FromStringAndSize(NULL, n * (Py_ssize_t)sizeof(Py_ssize_t));
+    if (data == NULL)
+        return NULL;
+    Py_ssize_t *order = (Py_ssize_t *)PyBytes_AS_STRING(data);
+    for (Py_ssize_t i = 0; i < n; i++)
+        order[i] = (Py_ssize_t)(uintptr_t)indices[i];
+
+    PyObject *result = NULL;
+    PyObject *array_module = PyImport_ImportModule("array");
+    if (array_module != NULL) {
+        result = PyObject_CallMethod(array_module, "array", "sO", INDEX_TYPECODE, data);
+        Py_DECREF(array_module);
+    }
+    Py_DECREF(data);
+    return result;
+}
+
+/*
+   The index permutation counterpart of list_select(): return an array.array
+   of the indices 0..n-1 of the list values, arranged so that the values they
+   refer to are partitioned around each of the nks sorted indices ks, and
+   leave values itself in its original order. The selection runs on the
+   same engine as the in-place functions, with the values (or their keys) as
+   the keys and the indices as the items. The engine never looks at the
+   items when it has keys, so the indices are stored in the item pointers
+   themselves and no index objects are created.
+   values may also be a tuple.
+*/
+static PyObject *
+list_argselect(PyObject *values, const Py_ssize_t *ks, Py_ssize_t nks, PyObject *key,
+               int reverse)
+{
+    Py_ssize_t n = Py_SIZE(values);
+    if (nks > 0 && (ks[0] < 0 || ks[nks - 1] >= n)) {
+        PyErr_SetString(PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+    if (key != Py_None && !PyCallable_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "key must be callable");
+        return NULL;
+    }
+
+    PyObject *result = NULL;
+    PyObject **keys = NULL;
+    PyObject **indices = PyMem_New(PyObject *, n > 0 ? n : 1);
+    if (indices == NULL)
+        return PyErr_NoMemory();
+    for (Py_ssize_t i = 0; i < n; i++)
+        indices[i] = (PyObject *)(uintptr_t)i;
+
+    /* Without a key the values are the keys, and the selection reorders
+       the scratch copy of them; the copy of a list holds references to its
+       values, so other code may change the list meanwhile. */
+    int is_list = PyList_Check(values);
+    PyObject **items = scratch_copy(PySequence_Fast_ITEMS(values), n, is_list);
+    if (items == NULL)
+        goto done;
+    if (key != Py_None) {
+        keys = compute_keys(key, items, n);
+        if (keys == NULL)
+            goto done;
+    }
+    else {
+        keys = items;
+    }
+
+    SelectState st;
+    select_state_init(&st, indices, keys, n, reverse);
+    if (nks == 0 ||
+        select_items(indices, keys, n, ks, nks, nth_element_method(n, ks[0]), &st) == 0)
+        result = index_array(indices, n);
+
+done:
+    if (key != Py_None)
+        free_objects(keys, n);
+    if (items != NULL)
+        scratch_release(items, n, is_list);
+    PyMem_Free(indices);
+    return result;
+}
+
+/*
+   The number of items in a sequence or numeric buffer, or -1 with an
+   exception set if values is neither.
+*/
+static Py_ssize_t
+values_length(PyObject *values)
+{
+    if (PyList_Check(values) || PyTuple_Check(values))
+        return Py_SIZE(values);
+    if (!PyObject_CheckBuffer(values)) {
+        if (PySequence_Check(values))
+            return PySequence_Size(values);
+        PyErr_SetString(PyExc_TypeError, "values must be a sequence or numeric buffer");
+        return -1;
+    }
+    Py_buffer view;
+    BufferKind kind;
+    if (get_numeric_buffer(values, &view, 0, &kind) < 0)
+        return -1;
+    Py_ssize_t n = view.shape[0];
+    PyBuffer_Release(&view);
+    return n;
+}
+
+/*
+   The values of the functions that do not reorder them: numeric buffers,
+   lists and tuples are used as they are, and any other iterable (a dict
+   view, a generator, ...) is read once into a new list, as by
+   PySequence_Fast(). So are the buffers that cannot be read in place, with
+   a non-numeric format (array('u'), ...) or a strided layout (a sliced
+   memoryview or NumPy view). Returns a new reference, or NULL with an
+   exception set.
+*/
+static PyObject *
+values_fast(PyObject *values)
+{
+    if (!PyList_Check(values) && !PyTuple_Check(values) &&
+        PyObject_CheckBuffer(values)) {
+        Py_buffer view;
+        BufferKind kind;
+        if (get_numeric_buffer(values, &view, 0, &kind) == 0) {
+            PyBuffer_Release(&view);
+            Py_INCREF(values);
+            return values;
+        }
+        if (!PyErr_ExceptionMatches(PyExc_TypeError) &&
+            !PyErr_ExceptionMatches(PyExc_BufferError))
+            return NULL;
+        PyErr_Clear();
+    }
+    return PySequence_Fast(values, "values must be iterable or a numeric buffer");
+}
+
+/* qsort() comparison for Py_ssize_t values. */
+static int
+compare_ssize(const void *a, const void *b)
+{
+    Py_ssize_t x = *(const Py_ssize_t *)a, y = *(const Py_ssize_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort the m indices in ks and drop duplicates; returns how many remain. */
+static Py_ssize_t
+sort_unique(Py_ssize_t *ks, Py_ssize_t m)
+{
+    qsort(ks, (size_t)m, sizeof(Py_ssize_t), compare_ssize);
+    Py_ssize_t unique = 0;
+    for (Py_ssize_t i = 0; i < m; i++) {
+        if (unique == 0 || ks[i] != ks[unique - 1])
+            ks[unique++] = ks[i];
+    }
+    return unique;
+}
+
+/*
+   Convert an iterable of indices to a sorted array without duplicates,
+   stored in *ks (to be released with PyMem_Free()) with its length in *nks.
+   Returns 0 on success or -1 with an exception set.
+*/
+static int
+parse_indices(PyObject *indices, Py_ssize_t **ks, Py_ssize_t *nks)
+{
+    /* A tuple copy cannot be changed by the __index__ methods called below. */
+    PyObject *tuple = PySequence_Tuple(indices);
+    if (tuple == NULL)
+        return -1;
+    Py_ssize_t m = PyTuple_GET_SIZE(tuple);
+    Py_ssize_t *arr = PyMem_New(Py_ssize_t, m > 0 ? m : 1);
+    if (arr == NULL) {
+        Py_DECREF(tuple);
+        PyErr_NoMemory();
+        return -1;
+    }
+    for (Py_ssize_t i = 0; i < m; i++) {
+        arr[i] = PyNumber_AsSsize_t(PyTuple_GET_ITEM(tuple, i), PyExc_IndexError);
+        if (arr[i] == -1 && PyErr_Occurred()) {
+            Py_DECREF(tuple);
+            PyMem_Free(arr);
+            return -1;
+        }
+    }
+    Py_DECREF(tuple);
+
+    *ks = arr;
+    *nks = sort_unique(arr, m);
+    return 0;
+}
+
+/*
+   Check the keyword-only lo and hi arguments, which restrict the in-place
+   functions to values[lo:hi]. lo must be non-negative; hi may be None for
+   the end of values, and like a slice end it is clamped to the length.
+   On success, *index is made relative to lo. Returns 0, or -1 with an
+   exception set.
+*/
+static int
+parse_range(Py_ssize_t lo, PyObject *hi_obj, Py_ssize_t *hi, Py_ssize_t *index)
+{
+    if (lo < 0) {
+        PyErr_SetString(PyExc_ValueError, "lo must be non-negative");
+        return -1;
+    }
+    *hi = PY_SSIZE_T_MAX;
+    if (hi_obj != Py_None) {
+        *hi = PyNumber_AsSsize_t(hi_obj, NULL);
+        if (*hi == -1 && PyErr_Occurred())
+            return -1;
+    }
+    /* An index below lo stays negative, and is rejected as out of range. */
+    *index = *index < 0 ? -1 : *index - lo;
+    return 0;
+}
+
+/* ---------- public functions ---------- */
+
+/*
+   quickselect(values: list[Any], index: int, key=None, *, lo=0, hi=None,
+               reverse=False) -> None
+   Partition the list in‐place so that the element at the given index is in its
+   final sorted position. An optional key function may be provided, and lo/hi
+   restrict the partition to values[lo:hi] without copying the slice. With
+   reverse=True the order is descending, at the same cost as ascending.
+*/
+static PyObject *
+selectlib_quickselect(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "index", "key", "threads", "lo", "hi",
+                             "reverse", NULL};
+    PyObject *values;
+    Py_ssize_t target_index;
+    PyObject *key = Py_None;
+    int threads = 1;
+    Py_ssize_t lo = 0, hi;
+    PyObject *hi_obj = Py_None;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O$inOp:quickselect",
+                                     kwlist, &values, &target_index, &key,
+                                     &threads, &lo, &hi_obj, &reverse))
+        return NULL;
+    if (parse_range(lo, hi_obj, &hi, &target_index) < 0)
+        return NULL;
+
+    if (threads < 1) {
+        PyErr_SetString(PyExc_ValueError, "threads must be at least 1");
+        return NULL;
+    }
+
+    if (PyList_Check(values))
+        return list_select(values, &target_index, 1, key, SELECT_QUICK, lo, hi, reverse);
+    if (PyObject_CheckBuffer(values))
+        return buffer_select(values, &target_index, 1, key, SELECT_QUICK, threads,
+                             lo, hi, reverse);
+    return sequence_select(values, &target_index, 1, key, SELECT_QUICK, lo, hi, reverse);
+}
+
+/*
+   floydrivest(values: list[Any], index: int, key=None, *, lo=0, hi=None,
+               reverse=False) -> None
+   Partition the list in‐place so that the element at the given index is in its
+   final sorted position, using Floyd and Rivest's sampling selection, which
+   needs fewer comparisons than quickselect on large lists.
+*/
+static PyObject *
+selectlib_floydrivest(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "index", "key", "lo", "hi", "reverse",
+                             NULL};
+    PyObject *values;
+    Py_ssize_t target_index;
+    PyObject *key = Py_None;
+    Py_ssize_t lo = 0, hi;
+    PyObject *hi_obj = Py_None;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O$nOp:floydrivest",
+                                     kwlist, &values, &target_index, &key,
+                                     &lo, &hi_obj, &reverse))
+        return NULL;
+    if (parse_range(lo, hi_obj, &hi, &target_index) < 0)
+        return NULL;
+
+    if (PyList_Check(values))
+        return list_select(values, &target_index, 1, key, SELECT_FLOYD_RIVEST, lo, hi, reverse);
+    if (PyObject_CheckBuffer(values))
+        return buffer_select(values, &target_index, 1, key, SELECT_FLOYD_RIVEST, 1,
+                             lo, hi, reverse);
+    return sequence_select(values, &target_index, 1, key, SELECT_FLOYD_RIVEST, lo, hi, reverse);
+}
+
+/*
+   heapselect(values: list[Any], index: int, key=None, *, lo=0, hi=None,
+              reverse=False) -> None
+   Partition the list in‐place so that the element at the given index (k) is in its
+   final sorted position. This implementation uses a heap strategy (specifically,
+   building a fixed‐size max-heap on the first k+1 elements, then processing the rest)
+   to determine the kth smallest element.
+*/
+static PyObject *
+selectlib_heapselect(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "index", "key", "lo", "hi", "reverse",
+                             NULL};
+    PyObject *values;
+    Py_ssize_t target_index;
+    PyObject *key = Py_None;
+    Py_ssize_t lo = 0, hi;
+    PyObject *hi_obj = Py_None;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O$nOp:heapselect",
+                                     kwlist, &values, &target_index, &key,
+                                     &lo, &hi_obj, &reverse))
+        return NULL;
+    if (parse_range(lo, hi_obj, &hi, &target_index) < 0)
+        return NULL;
+
+    if (PyList_Check(values))
+        return list_select(values, &target_index, 1, key, SELECT_HEAP, lo, hi, reverse);
+    if (PyObject_CheckBuffer(values))
+        return buffer_select(values, &target_index, 1, key, SELECT_HEAP, 1,
+                             lo, hi, reverse);
+    return sequence_select(values, &target_index, 1, key, SELECT_HEAP, lo, hi, reverse);
+}
+
+/*
+   nth_element(values: list[Any], index: int, key=None, *, lo=0, hi=None,
+               reverse=False) -> None
+   Partition the list in‐place so that the element at the given index is in its
+   final sorted position. This interface adapts the selection algorithm as follows:
+     • If index is less than (len(values) >> 4), the heapselect method is used.
+     • Otherwise, Floyd-Rivest selection is used for at least FLOYD_RIVEST_MIN_SIZE
+       items and quickselect for fewer; both switch to median-of-medians pivots if
+       they exceed 4× the expected recursion depth (detected via iteration count).
+*/
+static PyObject *
+selectlib_nth_element(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "index", "key", "threads", "lo", "hi",
+                             "reverse", NULL};
+    PyObject *values;
+    Py_ssize_t target_index;
+    PyObject *key = Py_None;
+    int threads = 1;
+    Py_ssize_t lo = 0, hi;
+    PyObject *hi_obj = Py_None;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O$inOp:nth_element",
+                                     kwlist, &values, &target_index, &key,
+                                     &threads, &lo, &hi_obj, &reverse))
+        return NULL;
+    if (parse_range(lo, hi_obj, &hi, &target_index) < 0)
+        return NULL;
+
+    if (threads < 1) {
+        PyErr_SetString(PyExc_ValueError, "threads must be at least 1");
+        return NULL;
+    }
+
+    if (PyList_Check(values))
+        return list_select(values, &target_index, 1, key, SELECT_NTH, lo, hi, reverse);
+    if (PyObject_CheckBuffer(values))
+        return buffer_select(values, &target_index, 1, key, SELECT_NTH, threads,
+                             lo, hi, reverse);
+    return sequence_select(values, &target_index, 1, key, SELECT_NTH, lo, hi, reverse);
+}
+
+/*
+   nth_elements(values: list[Any], indices: Iterable[int], key=None, *,
+                reverse=False) -> None
+   Partition the list in‐place so that the element at each of the given indices
+   is in its final sorted position, reusing each partition step for all the
+   indices on either side of its pivot.
+*/
+static PyObject *
+selectlib_nth_elements(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "indices", "key", "reverse", NULL};
+    PyObject *values;
+    PyObject *indices;
+    PyObject *key = Py_None;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O$p:nth_elements",
+                                     kwlist, &values, &indices, &key, &reverse))
+        return NULL;
+
+    Py_ssize_t *ks;
+    Py_ssize_t nks;
+    if (parse_indices(indices, &ks, &nks) < 0)
+        return NULL;
+    PyObject *result;
+    if (PyList_Check(values))
+        result = list_select(values, ks, nks, key, SELECT_NTH, 0, PY_SSIZE_T_MAX, reverse);
+    else if (PyObject_CheckBuffer(values))
+        result = buffer_select(values, ks, nks, key, SELECT_NTH, 1, 0, PY_SSIZE_T_MAX,
+                               reverse);
+    else
+        result = sequence_select(values, ks, nks, key, SELECT_NTH, 0, PY_SSIZE_T_MAX,
+                                 reverse);
+    PyMem_Free(ks);
+    return result;
+}
+
+/*
+   partial_sort(values: list[Any], k: int, key=None, *, reverse=False) -> None
+   Rearrange the list in‐place so that its first k items are the k smallest,
+   in sorted order, like sorted(values)[:k] except that equal items may come
+   out in any order. The kth smallest item is selected as by nth_element and
+   the items before it are then sorted.
+*/
+static PyObject *
+selectlib_partial_sort(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "k", "key", "reverse", NULL};
+    PyObject *values;
+    Py_ssize_t k;
+    PyObject *key = Py_None;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O$p:partial_sort",
+                                     kwlist, &values, &k, &key, &reverse))
+        return NULL;
+
+    if (k < 0) {
+        PyErr_SetString(PyExc_ValueError, "k must be non-negative");
+        return NULL;
+    }
+    Py_ssize_t n = values_length(values);
+    if (n < 0)
+        return NULL;
+
+    /* Select the last index of the sorted prefix; an empty prefix selects nothing. */
+    Py_ssize_t last = Py_MIN(k, n) - 1;
+    Py_ssize_t nks = last >= 0;
+    if (PyList_Check(values))
+        return list_select(values, &last, nks, key, SELECT_PARTIAL_SORT, 0, PY_SSIZE_T_MAX,
+                           reverse);
+    if (PyObject_CheckBuffer(values))
+        return buffer_select(values, &last, nks, key, SELECT_PARTIAL_SORT, 1, 0,
+                             PY_SSIZE_T_MAX, reverse);
+    return sequence_select(values, &last, nks, key, SELECT_PARTIAL_SORT, 0, PY_SSIZE_T_MAX,
+                           reverse);
+}
+
+/*
+   Whether the item at index a belongs above the one at index b in the heap
+   of select_n(): the root is the item that leaves first, the one with the
+   largest key (the smallest with min_heap set) and, among equal keys, the
+   latest. Returns 1 or 0, or -1 if a comparison raised.
+*/
+static int
+heap_above(PyObject **kv, Py_ssize_t a, Py_ssize_t b, int min_heap, SelectState *st)
+{
+    int cmp = min_heap ? less_than(kv[a], kv[b], st) : less_than(kv[b], kv[a], st);
+    if (cmp != 0)
+        return cmp;
+    cmp = min_heap ? less_than(kv[b], kv[a], st) : less_than(kv[a], kv[b], st);
+    if (cmp != 0)
+        return cmp < 0 ? -1 : 0;
+    return a > b;
+}
+
+/*
+   Sift heap[i] down the binary heap of item indices heap[0..size) ordered by
+   heap_above(). Returns 0, or -1 if a comparison raised.
 */
 static int
-partition_by_pivot(PyObject *list, PyObject **keys, Py_ssize_t n, PyObject *pivot,
-                   Py_ssize_t *low, Py_ssize_t *mid)
+sift_down_indices(Py_ssize_t *heap, Py_ssize_t size, Py_ssize_t i,
+                  PyObject **kv, int min_heap, SelectState *st)
 {
-    Py_ssize_t i = 0, j = 0, k = n - 1;
-    int cmp_lt, cmp_gt;
-    while (j <= k) {
-        PyObject *current = keys ? keys[j] : PyList_GET_ITEM(list, j);
-        cmp_lt = less_than(current, pivot);
-        cmp_gt = less_than(pivot, current);
-        if (cmp_lt < 0 || cmp_gt < 0)
-            return -1;
-        if (cmp_lt == 1) {  /* current < pivot */
-            swap_items(list, i, j, keys);
-            i++; j++;
-        }
-        else if (cmp_lt == 0 && cmp_gt == 0) {  /* current == pivot */
-            j++;
+    Py_ssize_t item = heap[i];
+    int ret = 0;
+    for (;;) {
+        Py_ssize_t child = 2 * i + 1;
+        if (child >= size)
+            break;
+        if (child + 1 < size) {
+            int cmp = heap_above(kv, heap[child + 1], heap[child], min_heap, st);
+            if (cmp < 0) {
+                ret = -1;
+                break;
+            }
+            child += cmp;
         }
-        else {  /* current > pivot */
-            swap_items(list, j, k, keys);
-            k--;
+        int cmp = heap_above(kv, heap[child], item, min_heap, st);
+        if (cmp <= 0) {
+            ret = cmp;
+            break;
         }
+        heap[i] = heap[child];
+        i = child;
     }
-    *low = i;
-    *mid = j;
-    return 0;
+    heap[i] = item;
+    return ret;
 }
 
 /*
-   Original in‐place quickselect implementation with an added iteration counter.
-   It partitions the list (and keys array if provided) so that the element at index k
-   is in its final sorted position.
-   If the number of iterations exceeds 4× the expected maximum recursion depth,
-   the function returns -2 to signal that a fallback is desired.
+   The n smallest items of iterable (or the n largest, if largest is set) in
+   a new list, ordered like sorted(iterable, key=key)[:n] (with reverse=True
+   for the largest), which is also what heapq.nsmallest() and nlargest()
+   return. Small n are found like heapq does, with a heap of the indices of
+   the n best items so far in which equal keys give way to the earliest.
+   Otherwise the nth key is selected on a scratch copy of the keys, and a
+   scan in the original order keeps every item beyond it and the first of
+   the items equal to it. Either way ties come out in their original order,
+   and the kept items are finally merge sorted, which is stable.
 */
-static int
-quickselect_inplace(PyObject *list, PyObject **keys,
-                    Py_ssize_t left, Py_ssize_t right, Py_ssize_t k)
+static PyObject *
+select_n(Py_ssize_t n, PyObject *iterable, PyObject *key, int largest)
 {
-    static int seeded = 0;
-    if (!seeded) {
-        srand((unsigned)time(NULL));
-        seeded = 1;
+    if (key != Py_None && !PyCallable_Check(key)) {
+        PyErr_SetString(PyExc_TypeError, "key must be callable");
+        return NULL;
     }
-    int iterations = 0;
-    /* Compute a max iteration limit: 4 times (1 + log₂(n)) */
-    double log_val = log((double)(right - left + 1)) / log(2.0);
-    long max_iter = 4 * (1 + (long)log_val);
+    /* The items are read into a new list that no other code can see, so key
+       functions and comparisons may change iterable itself meanwhile, as
+       with heapq. */
+    PyObject *list = PySequence_List(iterable);
+    if (list == NULL)
+        return NULL;
+    PyObject **items = PySequence_Fast_ITEMS(list);
+    Py_ssize_t size = PyList_GET_SIZE(list);
+    n = Py_MAX(0, Py_MIN(n, size));
 
-    while (left < right) {
-        iterations++;
-        if (iterations > max_iter)
-            return -2;
-        Py_ssize_t pivot_index = left + rand() % (right - left + 1);
-        Py_ssize_t pos;
-        /* Move pivot to the end */
-        swap_items(list, pivot_index, right, keys);
-        PyObject *pivot_val = keys ? keys[right] : PyList_GET_ITEM(list, right);
-        pos = left;
-        for (Py_ssize_t i = left; i < right; i++) {
-            PyObject *current = keys ? keys[i] : PyList_GET_ITEM(list, i);
-            int cmp = less_than(current, pivot_val);
+    PyObject *result = NULL;
+    PyObject **keys = NULL, **chosen = NULL, **work = NULL;
+    Py_ssize_t *heap = NULL;
+    char *side = NULL;
+    if (key != Py_None) {
+        keys = compute_keys(key, items, size);
+        if (keys == NULL)
+            goto done;
+    }
+    PyObject **kv = keys ? keys : items;
+    SelectState st;
+    select_state_init(&st, items, keys, size, 0);
+
+    /* The kept items and their keys, in their original order. */
+    chosen = PyMem_New(PyObject *, 2 * n > 0 ? 2 * n : 1);
+    if (chosen == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+    PyObject **chosen_keys = chosen + n;
+    Py_ssize_t count = 0;
+    if (n == size) {
+        /* An empty input has no item array to copy from. */
+        if (n > 0) {
+            memcpy(chosen, items, (size_t)n * sizeof(PyObject *));
+            memcpy(chosen_keys, kv, (size_t)n * sizeof(PyObject *));
+        }
+        count = n;
+    }
+    else if (n > 0 && n < (size >> 4)) {
+        heap = PyMem_New(Py_ssize_t, n);
+        if (heap == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        for (Py_ssize_t i = 0; i < n; i++)
+            heap[i] = i;
+        for (Py_ssize_t i = n / 2 - 1; i >= 0; i--) {
+            if (sift_down_indices(heap, n, i, kv, largest, &st) < 0)
+                goto done;
+        }
+        /* A later item only displaces the root if its key is strictly better. */
+        for (Py_ssize_t i = n; i < size; i++) {
+            PyObject *root = kv[heap[0]];
+            int cmp = largest ? less_than(root, kv[i], &st) : less_than(kv[i], root, &st);
             if (cmp < 0)
-                return -1;
-            if (cmp == 1) {
-                swap_items(list, i, pos, keys);
-                pos++;
+                goto done;
+            if (cmp) {
+                heap[0] = i;
+                if (sift_down_indices(heap, n, 0, kv, largest, &st) < 0)
+                    goto done;
             }
         }
-        swap_items(list, pos, right, keys);
-        if (pos == k)
-            return 0;
-        else if (k < pos)
-            right = pos - 1;
-        else
-            left = pos + 1;
+        qsort(heap, (size_t)n, sizeof(Py_ssize_t), compare_ssize);
+        for (; count < n; count++) {
+            chosen[count] = items[heap[count]];
+            chosen_keys[count] = kv[heap[count]];
+        }
     }
-    return 0;
+    else if (n > 0) {
+        work = PyMem_New(PyObject *, size);
+        side = PyMem_Malloc((size_t)size);
+        if (work == NULL || side == NULL) {
+            PyErr_NoMemory();
+            goto done;
+        }
+        memcpy(work, kv, (size_t)size * sizeof(PyObject *));
+        Py_ssize_t k = largest ? size - n : n - 1;
+        if (select_items(work, NULL, size, &k, 1, nth_element_method(size, k), &st) < 0)
+            goto done;
+        PyObject *pivot = work[k];
+
+        /* side[i] is 2 for the keys beyond the pivot, 1 for the keys equal
+           to it and 0 for the rest; the rest take a single comparison. */
+        Py_ssize_t beyond = 0;
+        for (Py_ssize_t i = 0; i < size; i++) {
+            int cmp = largest ? less_than(kv[i], pivot, &st) : less_than(pivot, kv[i], &st);
+            if (cmp < 0)
+                goto done;
+            side[i] = 0;
+            if (cmp)
+                continue;
+            cmp = largest ? less_than(pivot, kv[i], &st) : less_than(kv[i], pivot, &st);
+            if (cmp < 0)
+                goto done;
+            side[i] = cmp ? 2 : 1;
+            beyond += cmp;
+        }
+        Py_ssize_t ties = n - beyond;
+        for (Py_ssize_t i = 0; i < size && count < n; i++) {
+            if (side[i] == 2 || (side[i] == 1 && ties-- > 0)) {
+                chosen[count] = items[i];
+                chosen_keys[count] = kv[i];
+                count++;
+            }
+        }
+    }
+
+    /* Sorting the reversed items and reversing the result keeps equal
+       items in their original order, as sorted(reverse=True) does. */
+    if (largest) {
+        for (Py_ssize_t i = 0, j = count - 1; i < j; i++, j--)
+            swap_items(chosen, i, j, chosen_keys);
+    }
+    if (sort_items(chosen, chosen_keys, count, &st) < 0)
+        goto done;
+    if (largest) {
+        for (Py_ssize_t i = 0, j = count - 1; i < j; i++, j--)
+            swap_items(chosen, i, j, chosen_keys);
+    }
+
+    result = PyList_New(count);
+    if (result == NULL)
+        goto done;
+    for (Py_ssize_t i = 0; i < count; i++) {
+        Py_INCREF(chosen[i]);
+        PyList_SET_ITEM(result, i, chosen[i]);
+    }
+
+done:
+    PyMem_Free(side);
+    PyMem_Free(heap);
+    PyMem_Free(work);
+    PyMem_Free(chosen);
+    free_objects(keys, size);
+    Py_DECREF(list);
+    return result;
 }
 
 /*
-   quickselect(values: list[Any], index: int, key=None) -> None
-   Partition the list in‐place so that the element at the given index is in its
-   final sorted position. An optional key function may be provided.
+   nsmallest(n: int, iterable: Iterable[Any], key=None) -> list[Any]
+   A drop-in replacement for heapq.nsmallest().
 */
 static PyObject *
-selectlib_quickselect(PyObject *self, PyObject *args, PyObject *kwargs)
+selectlib_nsmallest(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"n", "iterable", "key", NULL};
+    Py_ssize_t n;
+    PyObject *iterable;
+    PyObject *key = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "nO|O:nsmallest",
+                                     kwlist, &n, &iterable, &key))
+        return NULL;
+    return select_n(n, iterable, key, 0);
+}
+
+/*
+   nlargest(n: int, iterable: Iterable[Any], key=None) -> list[Any]
+   A drop-in replacement for heapq.nlargest().
+*/
+static PyObject *
+selectlib_nlargest(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"n", "iterable", "key", NULL};
+    Py_ssize_t n;
+    PyObject *iterable;
+    PyObject *key = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "nO|O:nlargest",
+                                     kwlist, &n, &iterable, &key))
+        return NULL;
+    return select_n(n, iterable, key, 1);
+}
+
+/*
+   select(values: list[Any], index: int, key=None, *, reverse=False) -> Any
+   Return the element that nth_element would place at the given index,
+   without reordering values. Lists and tuples are selected on a reusable
+   scratch copy of their item pointers, so no list is copied.
+*/
+static PyObject *
+selectlib_select(PyObject *self, PyObject *args, PyObject *kwargs)
 {
-    static char *kwlist[] = {"values", "index", "key", NULL};
+    static char *kwlist[] = {"values", "index", "key", "reverse", NULL};
     PyObject *values;
     Py_ssize_t target_index;
     PyObject *key = Py_None;
+    int reverse = 0;
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O:quickselect",
-                                     kwlist, &values, &target_index, &key))
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O$p:select",
+                                     kwlist, &values, &target_index, &key, &reverse))
         return NULL;
 
-    if (!PyList_Check(values)) {
-        PyErr_SetString(PyExc_TypeError, "values must be a list");
+    values = values_fast(values);
+    if (values == NULL)
         return NULL;
-    }
+    PyObject *found;
+    int ret = select_values(values, &target_index, 1, key, reverse, &found);
+    Py_DECREF(values);
+    return ret < 0 ? NULL : found;
+}
 
-    Py_ssize_t n = PyList_Size(values);
-    if (target_index < 0 || target_index >= n) {
-        PyErr_SetString(PyExc_IndexError, "index out of range");
+/*
+   argselect(values: list[Any], index: int, key=None, *,
+             reverse=False) -> array.array
+   Return a permutation of range(len(values)) that would partition the list
+   around the given index, like nth_element on a copy of it, without
+   reordering the list itself: values[order[index]] is the element at that
+   sorted position.
+*/
+static PyObject *
+selectlib_argselect(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "index", "key", "reverse", NULL};
+    PyObject *values;
+    Py_ssize_t target_index;
+    PyObject *key = Py_None;
+    int reverse = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O$p:argselect",
+                                     kwlist, &values, &target_index, &key, &reverse))
         return NULL;
-    }
 
-    int use_key = 0;
-    if (key != Py_None) {
-        if (!PyCallable_Check(key)) {
-            PyErr_SetString(PyExc_TypeError, "key must be callable");
-            return NULL;
-        }
-        use_key = 1;
-    }
+    values = PySequence_Fast(values, "values must be iterable");
+    if (values == NULL)
+        return NULL;
+    PyObject *result = list_argselect(values, &target_index, 1, key, reverse);
+    Py_DECREF(values);
+    return result;
+}
 
-    PyObject **keys = NULL;
-    if (use_key) {
-        keys = PyMem_New(PyObject *, n);
-        if (keys == NULL) {
-            PyErr_NoMemory();
-            return NULL;
-        }
-        for (Py_ssize_t i = 0; i < n; i++) {
-            PyObject *item = PyList_GET_ITEM(values, i);
-            PyObject *keyval = PyObject_CallFunctionObjArgs(key, item, NULL);
-            if (keyval == NULL) {
-                for (Py_ssize_t j = 0; j < i; j++)
-                    Py_DECREF(keys[j]);
-                PyMem_Free(keys);
-                return NULL;
-            }
-            keys[i] = keyval;
-        }
-    }
+/*
+   argselect_many(values: list[Any], indices: Iterable[int], key=None, *,
+                  reverse=False) -> array.array
+   The multi-rank variant of argselect(), as nth_elements is of nth_element.
+*/
+static PyObject *
+selectlib_argselect_many(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"values", "indices", "key", "reverse", NULL};
+    PyObject *values;
+    PyObject *indices;
+    PyObject *key = Py_None;
+    int reverse = 0;
 
-    int ret = quickselect_inplace(values, keys, 0, n - 1, target_index);
-    if (ret == -2) {
-        /* Exceeded iteration limit; use heapselect fallback. */
-        if (keys) {
-            for (Py_ssize_t i = 0; i < n; i++)
-                Py_DECREF(keys[i]);
-            PyMem_Free(keys);
-        }
-        return selectlib_heapselect(self, args, kwargs);
-    }
-    else if (ret < 0) {
-        if (keys) {
-            for (Py_ssize_t i = 0; i < n; i++)
-                Py_DECREF(keys[i]);
-            PyMem_Free(keys);
-        }
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O$p:argselect_many",
+                                     kwlist, &values, &indices, &key, &reverse))
         return NULL;
-    }
-    if (keys) {
-        for (Py_ssize_t i = 0; i < n; i++)
-            Py_DECREF(keys[i]);
-        PyMem_Free(keys);
-    }
 
-    Py_RETURN_NONE;
+    Py_ssize_t *ks;
+    Py_ssize_t nks;
+    if (parse_indices(indices, &ks, &nks) < 0)
+        return NULL;
+    values = PySequence_Fast(values, "values must be iterable");
+    if (values == NULL) {
+        PyMem_Free(ks);
+        return NULL;
+    }
+    PyObject *result = list_argselect(values, ks, nks, key, reverse);
+    Py_DECREF(values);
+    PyMem_Free(ks);
+    return result;
 }
 
-/* ---------- heapselect implementation ---------- */
+/* Interpolation methods of quantiles(), named as in numpy.quantile(). */
+enum {
+    QUANTILE_LINEAR,
+    QUANTILE_LOWER,
+    QUANTILE_HIGHER,
+    QUANTILE_NEAREST,
+    QUANTILE_MIDPOINT
+};
 
-/* Structure to hold an element for the heap.
-   Each HeapItem contains a pointer to the list element (value) and
-   the corresponding key (if any; if not, key==value).
-*/
-typedef struct {
-    PyObject *value;
-    PyObject *key;
-} HeapItem;
+/* Index of k in the sorted array ks, which must contain it. */
+static Py_ssize_t
+rank_position(const Py_ssize_t *ks, Py_ssize_t nks, Py_ssize_t k)
+{
+    const Py_ssize_t *found = bsearch(&k, ks, (size_t)nks, sizeof(Py_ssize_t),
+                                      compare_ssize);
+    return found - ks;
+}
 
-/* Max-heap helper: Restore the max-heap property for heap[i] assuming
-   that the trees rooted at its children are valid.
+/*
+   The position last * q computed exactly, with q read as its shortest
+   decimal form (0.1 is 1/10) as fractions.Fraction(repr(q)) does: stores its
+   integer part in *pos and its fractional part as the integer ratio
+   *num / *den, with 0 <= *num < *den. Returns 0, or -1 with an exception set.
 */
-static void
-max_heapify(HeapItem *heap, Py_ssize_t heap_size, Py_ssize_t i)
+static int
+exact_position(double q, Py_ssize_t last, Py_ssize_t *pos, PyObject **num, PyObject **den)
 {
-    Py_ssize_t largest = i;
-    Py_ssize_t left = 2 * i + 1;
-    Py_ssize_t right = 2 * i + 2;
-    int cmp;
+    *num = *den = NULL;
+    char *text = PyOS_double_to_string(q, 'r', 0, 0, NULL);
+    if (text == NULL)
+        return -1;
+    PyObject *ratio = NULL;
+    PyObject *fractions = PyImport_ImportModule("fractions");
+    if (fractions != NULL) {
+        ratio = PyObject_CallMethod(fractions, "Fraction", "s", text);
+        Py_DECREF(fractions);
+    }
+    PyMem_Free(text);
+    if (ratio == NULL)
+        return -1;
+    PyObject *numerator = PyObject_GetAttrString(ratio, "numerator");
+    *den = PyObject_GetAttrString(ratio, "denominator");
+    Py_DECREF(ratio);
+    PyObject *factor = PyLong_FromSsize_t(last);
+    PyObject *scaled = numerator && *den && factor ? PyNumber_Multiply(numerator, factor) : NULL;
+    PyObject *parts = scaled ? PyNumber_Divmod(scaled, *den) : NULL;
+    Py_XDECREF(numerator);
+    Py_XDECREF(factor);
+    Py_XDECREF(scaled);
+    if (parts == NULL) {
+        Py_CLEAR(*den);
+        return -1;
+    }
+    *pos = PyLong_AsSsize_t(PyTuple_GET_ITEM(parts, 0));
+    *num = PyTuple_GET_ITEM(parts, 1);
+    Py_INCREF(*num);
+    Py_DECREF(parts);
+    if (*pos == -1 && PyErr_Occurred()) {
+        Py_CLEAR(*num);
+        Py_CLEAR(*den);
+        return -1;
+    }
+    return 0;
+}
 
-    if (left < heap_size) {
-        cmp = less_than(heap[largest].key, heap[left].key);
-        if (cmp == 1) {
-            largest = left;
+/*
+   The value at fractional position frac between lo and hi, computed with the
+   values' own arithmetic. If num is not NULL, the exact ratio num / den of
+   exact_position() is the weight instead of frac, so that numbers other than
+   ints and floats (Decimal, Fraction, ...) keep their own type.
+*/
+static PyObject *
+interpolate(PyObject *lo, PyObject *hi, double frac, PyObject *num, PyObject *den,
+            int method)
+{
+    if (lo == hi || (num == NULL && frac == 0.0)) {
+        Py_INCREF(lo);
+        return lo;
+    }
+    if (method == QUANTILE_MIDPOINT) {
+        PyObject *sum = PyNumber_Add(lo, hi);
+        if (sum == NULL)
+            return NULL;
+        PyObject *two = PyLong_FromLong(2);
+        if (two == NULL) {
+            Py_DECREF(sum);
+            return NULL;
         }
+        PyObject *result = PyNumber_TrueDivide(sum, two);
+        Py_DECREF(sum);
+        Py_DECREF(two);
+        return result;
     }
-    if (right < heap_size) {
-        cmp = less_than(heap[largest].key, heap[right].key);
-        if (cmp == 1) {
-            largest = right;
+
+    /* lo + (hi - lo) * frac */
+    PyObject *diff = PyNumber_Subtract(hi, lo);
+    if (diff == NULL)
+        return NULL;
+    PyObject *step;
+    if (num == NULL) {
+        PyObject *weight = PyFloat_FromDouble(frac);
+        if (weight == NULL) {
+            Py_DECREF(diff);
+            return NULL;
         }
+        step = PyNumber_Multiply(diff, weight);
+        Py_DECREF(weight);
     }
-    if (largest != i) {
-        HeapItem temp = heap[i];
-        heap[i] = heap[largest];
-        heap[largest] = temp;
-        max_heapify(heap, heap_size, largest);
+    else {
+        /* lo + (hi - lo) * num / den */
+        PyObject *scaled = PyNumber_Multiply(diff, num);
+        step = scaled ? PyNumber_TrueDivide(scaled, den) : NULL;
+        Py_XDECREF(scaled);
     }
+    Py_DECREF(diff);
+    if (step == NULL)
+        return NULL;
+    PyObject *result = PyNumber_Add(lo, step);
+    Py_DECREF(step);
+    return result;
 }
 
-/* Build a max-heap from an array of HeapItem of size heap_size */
-static void
-build_max_heap(HeapItem *heap, Py_ssize_t heap_size)
+/*
+   Whether values, as returned by values_fast(), is a numeric buffer or holds
+   only plain ints and floats, whose quantiles are computed in floating point
+   as numpy does.
+*/
+static int
+values_are_real(PyObject *values)
 {
-    for (Py_ssize_t i = (heap_size / 2) - 1; i >= 0; i--) {
-        max_heapify(heap, heap_size, i);
+    if (!PyList_Check(values) && !PyTuple_Check(values))
+        return 1;
+    PyObject **items = PySequence_Fast_ITEMS(values);
+    for (Py_ssize_t i = 0; i < Py_SIZE(values); i++) {
+        if (!PyLong_CheckExact(items[i]) && !PyFloat_CheckExact(items[i]))
+            return 0;
     }
+    return 1;
 }
 
 /*
-   heapselect(values: list[Any], index: int, key=None) -> None
-   Partition the list in‐place so that the element at the given index (k) is in its
-   final sorted position. This implementation uses a heap strategy (specifically,
-   building a fixed‐size max-heap on the first k+1 elements, then processing the rest)
-   to determine the kth smallest element.
+   quantiles(values: list[Any], qs: Iterable[float], method="linear") -> list[Any]
+   Return the quantiles qs (each between 0 and 1) of values, without
+   reordering it. Quantile q lies at position h = (len(values) - 1) * q of the
+   sorted values; for fractional h the methods "linear", "lower", "higher",
+   "nearest" and "midpoint" combine the values at floor(h) and ceil(h) as in
+   numpy.quantile(). h is a float for ints and floats, and exact (see
+   exact_position()) for other numbers. All the positions are selected in one
+   multi-rank pass.
 */
 static PyObject *
-selectlib_heapselect(PyObject *self, PyObject *args, PyObject *kwargs)
+selectlib_quantiles(PyObject *self, PyObject *args, PyObject *kwargs)
 {
-    static char *kwlist[] = {"values", "index", "key", NULL};
+    static char *kwlist[] = {"values", "qs", "method", NULL};
+    static const char *method_names[] = {
+        "linear", "lower", "higher", "nearest", "midpoint", NULL
+    };
     PyObject *values;
-    Py_ssize_t target_index;
-    PyObject *key = Py_None;
+    PyObject *qs;
+    const char *method_name = "linear";
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O:heapselect",
-                                     kwlist, &values, &target_index, &key))
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|s:quantiles",
+                                     kwlist, &values, &qs, &method_name))
         return NULL;
 
-    if (!PyList_Check(values)) {
-        PyErr_SetString(PyExc_TypeError, "values must be a list");
+    int method = 0;
+    while (method_names[method] != NULL &&
+           strcmp(method_names[method], method_name) != 0)
+        method++;
+    if (method_names[method] == NULL) {
+        PyErr_SetString(PyExc_ValueError,
+                        "method must be 'linear', 'lower', 'higher', 'nearest' or 'midpoint'");
         return NULL;
     }
-    Py_ssize_t n = PyList_Size(values);
-    if (target_index < 0 || target_index >= n) {
-        PyErr_SetString(PyExc_IndexError, "index out of range");
+
+    Py_ssize_t n;
+    values = values_fast(values);
+    if (values == NULL || (n = values_length(values)) < 0) {
+        Py_XDECREF(values);
         return NULL;
     }
-
-    int use_key = 0;
-    if (key != Py_None) {
-        if (!PyCallable_Check(key)) {
-            PyErr_SetString(PyExc_TypeError, "key must be callable");
-            return NULL;
-        }
-        use_key = 1;
+    PyObject *qs_tuple = PySequence_Tuple(qs);
+    if (qs_tuple == NULL) {
+        Py_DECREF(values);
+        return NULL;
     }
-
-    /* If a key function is given, precompute keys for the entire list.
-       (This mirrors the approach in quickselect.)
-    */
-    PyObject **keys = NULL;
-    if (use_key) {
-        keys = PyMem_New(PyObject *, n);
-        if (keys == NULL) {
-            PyErr_NoMemory();
-            return NULL;
-        }
-        for (Py_ssize_t i = 0; i < n; i++) {
-            PyObject *item = PyList_GET_ITEM(values, i);
-            PyObject *keyval = PyObject_CallFunctionObjArgs(key, item, NULL);
-            if (keyval == NULL) {
-                for (Py_ssize_t j = 0; j < i; j++)
-                    Py_DECREF(keys[j]);
-                PyMem_Free(keys);
-                return NULL;
-            }
-            keys[i] = keyval;
-        }
-    }
-
-    /* Heap selection:
-       We want the kth smallest element (where k = target_index). Build a max-heap
-       of the first (target_index+1) items so that the heap’s root is the largest among
-       them (and hence the kth smallest overall so far). Then for each subsequent item,
-       if its key is less than the root, update the root and restore the heap.
-    */
-    Py_ssize_t heap_size = target_index + 1;
-    HeapItem *heap = PyMem_New(HeapItem, heap_size);
-    if (heap == NULL) {
-        if (keys) {
-            for (Py_ssize_t i = 0; i < n; i++)
-                Py_DECREF(keys[i]);
-            PyMem_Free(keys);
-        }
-        PyErr_NoMemory();
+    Py_ssize_t nq = PyTuple_GET_SIZE(qs_tuple);
+    if (nq > 0 && n == 0) {
+        Py_DECREF(qs_tuple);
+        Py_DECREF(values);
+        PyErr_SetString(PyExc_ValueError, "quantiles requires at least one data point");
         return NULL;
     }
 
-    for (Py_ssize_t i = 0; i < heap_size; i++) {
-        heap[i].value = PyList_GET_ITEM(values, i);
-        if (use_key)
-            heap[i].key = keys[i];
-        else
-            heap[i].key = PyList_GET_ITEM(values, i);
+    /* The floor and ceiling positions of each quantile, and the weight of
+       the ceiling: fracs[i] in floating point, or ratios[2 * i] /
+       ratios[2 * i + 1] exactly. */
+    PyObject *result = NULL;
+    PyObject **found = NULL;
+    Py_ssize_t nks = 0;
+    int exact = !values_are_real(values);
+    double *fracs = PyMem_New(double, nq > 0 ? nq : 1);
+    PyObject **ratios = PyMem_New(PyObject *, 2 * nq > 0 ? 2 * nq : 1);
+    Py_ssize_t *bounds = PyMem_New(Py_ssize_t, 2 * nq > 0 ? 2 * nq : 1);
+    Py_ssize_t *ks = PyMem_New(Py_ssize_t, 2 * nq > 0 ? 2 * nq : 1);
+    if (fracs == NULL || ratios == NULL || bounds == NULL || ks == NULL) {
+        PyMem_Free(ratios);
+        ratios = NULL;
+        PyErr_NoMemory();
+        goto done;
     }
-    build_max_heap(heap, heap_size);
-
-    for (Py_ssize_t i = heap_size; i < n; i++) {
-        PyObject *current_key = use_key ? keys[i] : PyList_GET_ITEM(values, i);
-        int cmp = less_than(current_key, heap[0].key);
-        if (cmp < 0) {
-            PyMem_Free(heap);
-            if (keys) {
-                for (Py_ssize_t j = 0; j < n; j++)
-                    Py_DECREF(keys[j]);
-                PyMem_Free(keys);
+    for (Py_ssize_t i = 0; i < 2 * nq; i++)
+        ratios[i] = NULL;
+    for (Py_ssize_t i = 0; i < nq; i++) {
+        double q = PyFloat_AsDouble(PyTuple_GET_ITEM(qs_tuple, i));
+        if (q == -1.0 && PyErr_Occurred())
+            goto done;
+        if (!(q >= 0.0 && q <= 1.0)) {
+            PyErr_SetString(PyExc_ValueError, "quantiles must be between 0 and 1");
+            goto done;
+        }
+        Py_ssize_t lo, hi;
+        int above_half, at_half;
+        if (exact) {
+            PyObject **ratio = ratios + 2 * i;
+            if (exact_position(q, n - 1, &lo, &ratio[0], &ratio[1]) < 0)
+                goto done;
+            int nonzero = PyObject_IsTrue(ratio[0]);
+            PyObject *twice = PyNumber_Add(ratio[0], ratio[0]);
+            if (nonzero < 0 || twice == NULL) {
+                Py_XDECREF(twice);
+                goto done;
             }
-            return NULL;
+            above_half = PyObject_RichCompareBool(twice, ratio[1], Py_GT);
+            at_half = PyObject_RichCompareBool(twice, ratio[1], Py_EQ);
+            Py_DECREF(twice);
+            if (above_half < 0 || at_half < 0)
+                goto done;
+            hi = lo + nonzero;
+            fracs[i] = 0.0;
         }
-        if (cmp == 1) {  /* current < heap root */
-            heap[0].value = PyList_GET_ITEM(values, i);
-            heap[0].key = current_key;
-            max_heapify(heap, heap_size, 0);
+        else {
+            double h = (double)(n - 1) * q;
+            lo = (Py_ssize_t)floor(h);
+            hi = (Py_ssize_t)ceil(h);
+            above_half = h - lo > 0.5;
+            at_half = h - lo == 0.5;
+            fracs[i] = h - lo;
+        }
+        hi = Py_MIN(hi, n - 1);
+        switch (method) {
+        case QUANTILE_LOWER:
+            hi = lo;
+            break;
+        case QUANTILE_HIGHER:
+            lo = hi;
+            break;
+        case QUANTILE_NEAREST:
+            /* Round half to even, like numpy. */
+            lo = hi = lo + (above_half || (at_half && (lo & 1)));
+            break;
         }
+        bounds[2 * i] = lo;
+        bounds[2 * i + 1] = hi;
+        ks[nks++] = lo;
+        ks[nks++] = hi;
     }
+    nks = sort_unique(ks, nks);
 
-    /* Save the pivot value and its key (if in use) from the heap’s root */
-    PyObject *pivot;
-    PyObject *pivot_key = NULL;
-    if (use_key) {
-        pivot_key = heap[0].key;
-        pivot = heap[0].value;
-    } else {
-        pivot = heap[0].value;
+    found = PyMem_New(PyObject *, nks > 0 ? nks : 1);
+    if (found == NULL) {
+        PyErr_NoMemory();
+        goto done;
     }
-    PyMem_Free(heap);
-
-    /* Partition the entire list around the pivot.
-       If a key function is in use, pass the computed pivot_key.
-    */
-    Py_ssize_t low, mid;
-    if (partition_by_pivot(values, keys, n, use_key ? pivot_key : pivot, &low, &mid) < 0) {
-        if (keys) {
-            for (Py_ssize_t i = 0; i < n; i++)
-                Py_DECREF(keys[i]);
-            PyMem_Free(keys);
-        }
-        return NULL;
+    if (select_values(values, ks, nks, Py_None, 0, found) < 0) {
+        PyMem_Free(found);
+        found = NULL;
+        goto done;
     }
 
-    if (!(target_index >= low && target_index < mid)) {
-        if (keys) {
-            for (Py_ssize_t i = 0; i < n; i++)
-                Py_DECREF(keys[i]);
-            PyMem_Free(keys);
+    result = PyList_New(nq);
+    if (result == NULL)
+        goto done;
+    for (Py_ssize_t i = 0; i < nq; i++) {
+        PyObject *lo = found[rank_position(ks, nks, bounds[2 * i])];
+        PyObject *hi = found[rank_position(ks, nks, bounds[2 * i + 1])];
+        PyObject *value = interpolate(lo, hi, fracs[i], ratios[2 * i], ratios[2 * i + 1],
+                                      method);
+        if (value == NULL) {
+            Py_CLEAR(result);
+            goto done;
         }
-        PyErr_SetString(PyExc_RuntimeError, "heapselect partition failed to locate the target index");
-        return NULL;
+        PyList_SET_ITEM(result, i, value);
     }
 
-    if (keys) {
-        for (Py_ssize_t i = 0; i < n; i++)
-            Py_DECREF(keys[i]);
-        PyMem_Free(keys);
+done:
+    if (found != NULL)
+        free_objects(found, nks);
+    if (ratios != NULL) {
+        for (Py_ssize_t i = 0; i < 2 * nq; i++)
+            Py_XDECREF(ratios[i]);
+        PyMem_Free(ratios);
     }
-
-    Py_RETURN_NONE;
+    PyMem_Free(ks);
+    PyMem_Free(bounds);
+    PyMem_Free(fracs);
+    Py_DECREF(qs_tuple);
+    Py_DECREF(values);
+    return result;
 }
 
 /*
-   nth_element(values: list[Any], index: int, key=None) -> None
-   Partition the list in‐place so that the element at the given index is in its
-   final sorted position. This interface adapts the selection algorithm as follows:
-     • If index is less than (len(values) >> 4), the heapselect method is used.
-     • Otherwise, quickselect is attempted. If quickselect exceeds 4× the expected
-       recursion depth (detected via iteration count), the routine falls back to heapselect.
+   median(values: list[Any], key=None, kind="low") -> Any
+   Return the median of values without reordering it. For an even count,
+   kind "low" and "high" pick the lower or upper middle value and "mean"
+   averages the two. Both middle values cost a single selection: the upper
+   one is selected and the lower one is the largest value before it.
 */
 static PyObject *
-selectlib_nth_element(PyObject *self, PyObject *args, PyObject *kwargs)
+selectlib_median(PyObject *self, PyObject *args, PyObject *kwargs)
 {
-    static char *kwlist[] = {"values", "index", "key", NULL};
+    static char *kwlist[] = {"values", "key", "kind", NULL};
     PyObject *values;
-    Py_ssize_t target_index;
     PyObject *key = Py_None;
+    const char *kind = "low";
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|O:nth_element",
-                                     kwlist, &values, &target_index, &key))
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|Os:median",
+                                     kwlist, &values, &key, &kind))
         return NULL;
 
-    if (!PyList_Check(values)) {
-        PyErr_SetString(PyExc_TypeError, "values must be a list");
-        return NULL;
-    }
-    Py_ssize_t n = PyList_Size(values);
-    if (n == 0 || target_index < 0 || target_index >= n) {
-        PyErr_SetString(PyExc_IndexError, "index out of range");
+    int low = strcmp(kind, "low") == 0;
+    int high = strcmp(kind, "high") == 0;
+    int mean = strcmp(kind, "mean") == 0;
+    if (!low && !high && !mean) {
+        PyErr_SetString(PyExc_ValueError, "kind must be 'low', 'high' or 'mean'");
         return NULL;
     }
 
-    /* If target_index is small compared to n, use heapselect directly */
-    if (target_index < (n >> 4)) {
-        return selectlib_heapselect(self, args, kwargs);
-    }
-
-    int use_key = 0;
-    if (key != Py_None) {
-        if (!PyCallable_Check(key)) {
-            PyErr_SetString(PyExc_TypeError, "key must be callable");
-            return NULL;
-        }
-        use_key = 1;
-    }
-
-    PyObject **keys = NULL;
-    if (use_key) {
-        keys = PyMem_New(PyObject *, n);
-        if (keys == NULL) {
-            PyErr_NoMemory();
-            return NULL;
-        }
-        for (Py_ssize_t i = 0; i < n; i++) {
-            PyObject *item = PyList_GET_ITEM(values, i);
-            PyObject *keyval = PyObject_CallFunctionObjArgs(key, item, NULL);
-            if (keyval == NULL) {
-                for (Py_ssize_t j = 0; j < i; j++)
-                    Py_DECREF(keys[j]);
-                PyMem_Free(keys);
-                return NULL;
-            }
-            keys[i] = keyval;
-        }
+    Py_ssize_t n;
+    values = values_fast(values);
+    if (values == NULL || (n = values_length(values)) < 0) {
+        Py_XDECREF(values);
+        return NULL;
     }
-
-    int ret;
-    ret = quickselect_inplace(values, keys, 0, n - 1, target_index);
-    if (ret == -2) {
-        /* Exceeded iteration threshold; fall back to heapselect. */
-        if (keys) {
-            for (Py_ssize_t i = 0; i < n; i++)
-                Py_DECREF(keys[i]);
-            PyMem_Free(keys);
-        }
-        return selectlib_heapselect(self, args, kwargs);
-    } else if (ret < 0) {
-        if (keys) {
-            for (Py_ssize_t i = 0; i < n; i++)
-                Py_DECREF(keys[i]);
-            PyMem_Free(keys);
-        }
+    if (n == 0) {
+        Py_DECREF(values);
+        PyErr_SetString(PyExc_ValueError, "median requires at least one data point");
         return NULL;
     }
 
-    if (keys) {
-        for (Py_ssize_t i = 0; i < n; i++)
-            Py_DECREF(keys[i]);
-        PyMem_Free(keys);
+    Py_ssize_t ks[2] = {(n - 1) / 2, n / 2};
+    Py_ssize_t nks = 2;
+    if (ks[0] == ks[1] || !mean) {
+        if (high)
+            ks[0] = ks[1];
+        nks = 1;
     }
+    PyObject *found[2];
+    int ret = select_values(values, ks, nks, key, 0, found);
+    Py_DECREF(values);
+    if (ret < 0)
+        return NULL;
+    if (nks == 1)
+        return found[0];
 
-    Py_RETURN_NONE;
+    PyObject *result = interpolate(found[0], found[1], 0.5, NULL, NULL, QUANTILE_MIDPOINT);
+    Py_DECREF(found[0]);
+    Py_DECREF(found[1]);
+    return result;
 }
 
 /* ---------- Module method definitions ---------- */
 static PyMethodDef selectlib_methods[] = {
     {"quickselect", (PyCFunction)selectlib_quickselect,
      METH_VARARGS | METH_KEYWORDS,
-     "quickselect(values: list[Any], index: int, key=None) -> None\n\n"
-     "Partition the list in-place so that the element at the given index is in its final sorted position."},
+     "quickselect(values: MutableSequence[Any] | Buffer, index: int, key=None, *, threads=1, lo=0, hi=None, reverse=False) -> None\n\n"
+     "Partition the list in-place so that the element at the given index is in its final sorted position. "
+     "Only values[lo:hi] is partitioned, and index must lie within it. "
+     "reverse=True orders from largest to smallest, so index 0 is the largest element. "
+     "Other mutable sequences, such as a UserList, are read once and written back with one slice assignment. "
+     "values may also be a writable one-dimensional numeric buffer such as an array.array; "
+     "large buffers are partitioned in parallel on up to the given number of threads "
+     "(at most 64, and one per 65536 items)."},
     {"heapselect", (PyCFunction)selectlib_heapselect,
      METH_VARARGS | METH_KEYWORDS,
-     "heapselect(values: list[Any], index: int, key=None) -> None\n\n"
-     "Partition the list in-place using a heap strategy so that the element at the given index is in its final sorted position."},
+     "heapselect(values: MutableSequence[Any] | Buffer, index: int, key=None, *, lo=0, hi=None, reverse=False) -> None\n\n"
+     "Partition the list in-place using a heap strategy so that the element at the given index is in its final sorted position. "
+     "Only values[lo:hi] is partitioned, and index must lie within it. "
+     "reverse=True orders from largest to smallest, so index 0 is the largest element. "
+     "Other mutable sequences, such as a UserList, are read once and written back with one slice assignment. "
+     "values may also be a writable one-dimensional numeric buffer such as an array.array."},
+    {"floydrivest", (PyCFunction)selectlib_floydrivest,
+     METH_VARARGS | METH_KEYWORDS,
+     "floydrivest(values: MutableSequence[Any] | Buffer, index: int, key=None, *, lo=0, hi=None, reverse=False) -> None\n\n"
+     "Partition the list in-place so that the element at the given index is in its final sorted position, "
+     "using Floyd-Rivest selection, which needs fewer comparisons than quickselect on large lists. "
+     "Only values[lo:hi] is partitioned, and index must lie within it. "
+     "reverse=True orders from largest to smallest, so index 0 is the largest element. "
+     "Other mutable sequences, such as a UserList, are read once and written back with one slice assignment. "
+     "values may also be a writable one-dimensional numeric buffer such as an array.array."},
     {"nth_element", (PyCFunction)selectlib_nth_element,
      METH_VARARGS | METH_KEYWORDS,
-     "nth_element(values: list[Any], index: int, key=None) -> None\n\n"
+     "nth_element(values: MutableSequence[Any] | Buffer, index: int, key=None, *, threads=1, lo=0, hi=None, reverse=False) -> None\n\n"
      "Partition the list in-place so that the element at the given index is in its final sorted position. "
-     "Uses heapselect if the target index is less than (len(values) >> 4) or if quickselect exceeds its iteration limit."},
+     "Uses heapselect if the target index is less than (len(values) >> 4), and otherwise Floyd-Rivest selection for large inputs or quickselect for small ones. "
+     "Only values[lo:hi] is partitioned, and index must lie within it. "
+     "reverse=True orders from largest to smallest, so index 0 is the largest element. "
+     "Other mutable sequences, such as a UserList, are read once and written back with one slice assignment. "
+     "values may also be a writable one-dimensional numeric buffer such as an array.array; "
+     "large buffers are partitioned in parallel on up to the given number of threads "
+     "(at most 64, and one per 65536 items)."},
+    {"nth_elements", (PyCFunction)selectlib_nth_elements,
+     METH_VARARGS | METH_KEYWORDS,
+     "nth_elements(values: MutableSequence[Any] | Buffer, indices: Iterable[int], key=None, *, reverse=False) -> None\n\n"
+     "Partition the list in-place so that the element at each of the given indices is in its final sorted position. "
+     "All indices are placed in a single multi-quickselect pass, which is much cheaper than one nth_element call per index. "
+     "reverse=True orders from largest to smallest. "
+     "Other mutable sequences, such as a UserList, are read once and written back with one slice assignment. "
+     "values may also be a writable one-dimensional numeric buffer such as an array.array."},
+    {"partial_sort", (PyCFunction)selectlib_partial_sort,
+     METH_VARARGS | METH_KEYWORDS,
+     "partial_sort(values: MutableSequence[Any] | Buffer, k: int, key=None, *, reverse=False) -> None\n\n"
+     "Rearrange the list in-place so that its first k items are the k smallest, in sorted order. "
+     "The kth smallest item is selected as by nth_element and the items before it are then sorted natively, "
+     "so no slice or separate sort call is needed. "
+     "With reverse=True the first k items are the k largest, in descending order. "
+     "The keys come out as in sorted(values)[:k], but equal items may be in any order: the sort is not stable. "
+     "Other mutable sequences, such as a UserList, are read once and written back with one slice assignment. "
+     "values may also be a writable one-dimensional numeric buffer such as an array.array."},
+    {"nsmallest", (PyCFunction)selectlib_nsmallest,
+     METH_VARARGS | METH_KEYWORDS,
+     "nsmallest(n: int, iterable: Iterable[Any], key=None) -> list[Any]\n\n"
+     "Return a list with the n smallest elements of iterable, like heapq.nsmallest: "
+     "equivalent to sorted(iterable, key=key)[:n], with equal elements in their original order. "
+     "The nth smallest key is found by selection on a copy, so the cost is linear in the size of iterable plus the sort of the n results."},
+    {"nlargest", (PyCFunction)selectlib_nlargest,
+     METH_VARARGS | METH_KEYWORDS,
+     "nlargest(n: int, iterable: Iterable[Any], key=None) -> list[Any]\n\n"
+     "Return a list with the n largest elements of iterable, like heapq.nlargest: "
+     "equivalent to sorted(iterable, key=key, reverse=True)[:n], with equal elements in their original order. "
+     "The nth largest key is found by selection on a copy, so the cost is linear in the size of iterable plus the sort of the n results."},
+    {"select", (PyCFunction)selectlib_select,
+     METH_VARARGS | METH_KEYWORDS,
+     "select(values: Iterable[Any] | Buffer, index: int, key=None, *, reverse=False) -> Any\n\n"
+     "Return the element that nth_element would place at the given index, without reordering values. "
+     "Lists and tuples are selected on a reusable scratch copy of their item pointers, "
+     "so no copy of the list is needed and the list stays untouched meanwhile; any other iterable is read into a list once. "
+     "values may also be a one-dimensional numeric buffer such as an array.array, which need not be writable."},
+    {"argselect", (PyCFunction)selectlib_argselect,
+     METH_VARARGS | METH_KEYWORDS,
+     "argselect(values: Iterable[Any], index: int, key=None, *, reverse=False) -> array.array\n\n"
+     "Return an array.array holding a permutation of range(len(values)) that partitions the list around the given index "
+     "without reordering it: values[order[index]] is the element that nth_element would place at index, "
+     "the indices before it refer to elements no greater and those after it to elements no smaller. "
+     "values may be any iterable; the indices refer to its iteration order."},
+    {"argselect_many", (PyCFunction)selectlib_argselect_many,
+     METH_VARARGS | METH_KEYWORDS,
+     "argselect_many(values: Iterable[Any], indices: Iterable[int], key=None, *, reverse=False) -> array.array\n\n"
+     "Return an array.array holding a permutation of range(len(values)) that partitions the list around each of the given indices, "
+     "as nth_elements would, without reordering it. All indices are placed in a single multi-quickselect pass. "
+     "values may be any iterable; the indices refer to its iteration order."},
+    {"quantiles", (PyCFunction)selectlib_quantiles,
+     METH_VARARGS | METH_KEYWORDS,
+     "quantiles(values: Iterable[Any] | Buffer, qs: Iterable[float], method='linear') -> list[Any]\n\n"
+     "Return the quantiles qs (each between 0 and 1) of values without reordering it. "
+     "Quantile q lies at position (len(values) - 1) * q of the sorted values; between two positions, "
+     "method 'linear', 'lower', 'higher', 'nearest' or 'midpoint' combines their values as numpy.quantile does. "
+     "All positions are found in a single multi-rank selection pass. values may be any iterable, "
+     "or a one-dimensional numeric buffer such as an array.array, which need not be writable."},
+    {"median", (PyCFunction)selectlib_median,
+     METH_VARARGS | METH_KEYWORDS,
+     "median(values: Iterable[Any] | Buffer, key=None, kind='low') -> Any\n\n"
+     "Return the median of values without reordering it. For an even number of values, "
+     "kind 'low' or 'high' returns the lower or upper middle value and 'mean' returns their average. "
+     "Both middle values are found with a single selection followed by a linear scan. values may be any iterable, "
+     "or a one-dimensional numeric buffer such as an array.array, which need not be writable."},
     {NULL, NULL, 0, NULL}
 };
 
@@ -549,6 +3677,7 @@ PyInit_selectlib(void)
     PyObject *m = PyModule_Create(&selectlibmodule);
     if (m == NULL)
         return NULL;
+    srand((unsigned)time(NULL));
     if (PyModule_AddStringConstant(m, "__version__", SELECTLIB_VERSION) < 0) {
         Py_DECREF(m);
         return NULL;
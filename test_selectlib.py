@@ -4,6 +4,13 @@ Tests for both quickselect and heapselect implementations,
 as well as the version attribute.
 """
 
+import array
+import collections
+import decimal
+import fractions
+import heapq
+import math
+import threading
 import unittest
 import random
 import selectlib
@@ -16,6 +23,7 @@ class TestSelectLib(unittest.TestCase):
             ('quickselect', selectlib.quickselect),
             ('heapselect', selectlib.heapselect),
             ('nth_element', selectlib.nth_element),
+            ('floydrivest', selectlib.floydrivest),
         ]
 
     def sorted_index_check(self, func, values, k, key=None):
@@ -95,12 +103,911 @@ class TestSelectLib(unittest.TestCase):
                 for item in values[k + 1 :]:
                     self.assertGreaterEqual(-item, -kth_value)
 
+    def test_key_called_once_per_item(self):
+        for name, func in self.algorithms:
+            for k in (3, 500):
+                with self.subTest(algorithm=name, k=k):
+                    calls = []
+
+                    def key(x):
+                        calls.append(x)
+                        return -x
+
+                    values = list(range(1000))
+                    random.shuffle(values)
+                    func(values, k, key=key)
+                    self.assertEqual(values[k], 999 - k)
+                    self.assertEqual(len(calls), len(values))
+
+    def test_large_lists(self):
+        # Exercise the block partition on lists longer than its block size,
+        # including all-equal lists and lists with few distinct values.
+        cases = [
+            [random.randint(0, 10**6) for _ in range(5000)],
+            [random.randint(0, 3) for _ in range(5000)],
+            [7] * 5000,
+            list(range(5000)),
+            ['s%d' % random.randint(0, 50) for _ in range(5000)],
+        ]
+        for name, func in self.algorithms:
+            for values in cases:
+                with self.subTest(algorithm=name, first=values[0]):
+                    k = random.randint(0, len(values) - 1)
+                    self.sorted_index_check(func, list(values), k)
+
+    def test_large_heapselect(self):
+        # Heaps of at least 2**20 cheaply compared keys use the 4-ary layout.
+        n = (1 << 20) + 5000
+        values = [random.randint(0, 10**9) for _ in range(n)]
+        expected = sorted(values)
+        for k in (1 << 20, n - 1):
+            with self.subTest(k=k):
+                data = list(values)
+                selectlib.heapselect(data, k)
+                self.assertEqual(data[k], expected[k])
+                self.assertLessEqual(max(data[:k]), data[k])
+                self.assertGreaterEqual(min(data[k:]), data[k])
+        with self.subTest(key=True):
+            data = list(values)
+            selectlib.heapselect(data, 1 << 20, key=lambda x: -x)
+            self.assertEqual(data[1 << 20], expected[n - 1 - (1 << 20)])
+
+    def test_comparison_error(self):
+        # An exception raised by __lt__ propagates and leaves a permutation.
+        class Flaky:
+            calls = 0
+
+            def __init__(self, value):
+                self.value = value
+
+            def __lt__(self, other):
+                Flaky.calls += 1
+                if Flaky.calls > 300:
+                    raise ValueError('comparison failed')
+                return self.value < other.value
+
+        for name, func in self.algorithms:
+            for k in (10, 500):
+                with self.subTest(algorithm=name, k=k):
+                    Flaky.calls = 0
+                    values = [Flaky(random.random()) for _ in range(1000)]
+                    before = sorted(id(v) for v in values)
+                    with self.assertRaises(ValueError):
+                        func(values, k)
+                    self.assertEqual(sorted(id(v) for v in values), before)
+
+    def test_mutation_during_selection(self):
+        # The list is detached while it is selected on, as in list.sort():
+        # changes made by __lt__ or the key function raise ValueError and
+        # are discarded, leaving a permutation of the original items.
+        values = []
+
+        class Mutator:
+            def __init__(self, value):
+                self.value = value
+
+            def __lt__(self, other):
+                values.append(self)
+                return self.value < other.value
+
+        def appending_key(item):
+            values.append(item)
+            return item
+
+        for name, func in self.algorithms:
+            with self.subTest(algorithm=name, mutate='__lt__'):
+                values[:] = [Mutator(random.random()) for _ in range(100)]
+                before = sorted(id(v) for v in values)
+                with self.assertRaises(ValueError):
+                    func(values, 50)
+                self.assertEqual(sorted(id(v) for v in values), before)
+            with self.subTest(algorithm=name, mutate='key'):
+                values[:] = [random.random() for _ in range(100)]
+                before = sorted(values)
+                with self.assertRaises(ValueError):
+                    func(values, 50, key=appending_key)
+                self.assertEqual(sorted(values), before)
+
+    def test_floydrivest_comparisons(self):
+        # Floyd-Rivest needs markedly fewer comparisons than random pivots
+        # (about 3n on average).
+        class Counted:
+            calls = 0
+
+            def __init__(self, value):
+                self.value = value
+
+            def __lt__(self, other):
+                Counted.calls += 1
+                return self.value < other.value
+
+        n = 20000
+        data = [random.random() for _ in range(n)]
+        for k in (0, n // 10, n // 2, n - 1):
+            with self.subTest(k=k):
+                values = [Counted(x) for x in data]
+                Counted.calls = 0
+                selectlib.floydrivest(values, k)
+                self.assertEqual(values[k].value, sorted(data)[k])
+                self.assertLess(Counted.calls, 2.5 * n)
+
+    def test_median_of_medians_fallback(self):
+        # McIlroy's adversary assigns values lazily, so that every random
+        # pivot turns out to be one of the smallest remaining items. That
+        # makes plain quickselect quadratic (about n**2 / 5 comparisons);
+        # the median-of-medians fallback keeps it to a few dozen n.
+        values = {}
+
+        class Adversary:
+            def __init__(self, index):
+                self.index = index
+
+            def __lt__(self, other):
+                Adversary.calls += 1
+                if self.index not in values and other.index not in values:
+                    values[self.index] = len(values)
+                    values[other.index] = len(values)
+                inf = float('inf')
+                return values.get(self.index, inf) < values.get(other.index, inf)
+
+        n = 3000
+        k = n // 2
+        calls = []
+
+        def key(index):
+            calls.append(index)
+            return Adversary(index)
+
+        Adversary.calls = 0
+        data = list(range(n))
+        selectlib.quickselect(data, k, key=key)
+        self.assertEqual(len(calls), n)
+        self.assertLess(Adversary.calls, n * n // 8)
+        # Items never compared with each other are still unordered and
+        # rank above every assigned value.
+        ranks = [values.get(index, float('inf')) for index in data]
+        self.assertLessEqual(max(ranks[:k]), ranks[k])
+        self.assertGreaterEqual(min(ranks[k:]), ranks[k])
+
+    def test_int_fast_path(self):
+        # Single-digit ints take the specialized comparison; large ints, bools
+        # and mixed int/float lists must still order correctly.
+        cases = [
+            [random.randint(-(2**29), 2**29) for _ in range(200)],
+            [random.randint(-(2**80), 2**80) for _ in range(200)],
+            [random.randint(-5, 5) for _ in range(100)] + [2**70, -(2**70)],
+            [random.choice([True, False]) for _ in range(50)],
+            [random.randint(0, 100) for _ in range(50)] + [0.5, 99.5],
+        ]
+        for name, func in self.algorithms:
+            for values in cases:
+                with self.subTest(algorithm=name, first=values[0]):
+                    k = random.randint(0, len(values) - 1)
+                    self.sorted_index_check(func, list(values), k)
+
+    def test_float_fast_path(self):
+        # Lists of exact floats (or float keys) are selected on raw doubles.
+        for name, func in self.algorithms:
+            for n in (1, 2, 17, 500):
+                with self.subTest(algorithm=name, n=n):
+                    values = [random.uniform(-1e6, 1e6) for _ in range(n)]
+                    values[0] = float('inf')
+                    values[-1] = -0.0
+                    k = random.randint(0, n - 1)
+                    self.sorted_index_check(func, values, k)
+            with self.subTest(algorithm=name, key=True):
+                values = [random.randint(0, 1000) for _ in range(300)]
+                self.sorted_index_check(func, values, 150, key=lambda x: x / 7.0)
+            with self.subTest(algorithm=name, duplicates=True):
+                values = [1.5] * 100 + [0.5] * 50
+                self.sorted_index_check(func, values, 120)
+
+    def test_str_and_bytes_fast_path(self):
+        # Latin-1 strings and bytes compare with memcmp; wider strings and
+        # mixed lists fall back to the generic comparison.
+        latin = ['host%d' % random.randint(0, 500) for _ in range(200)]
+        cases = [
+            latin,
+            latin + ['', 'host', 'h\xe9te', 'host1\x00'],
+            latin + ['h\u00e9\u4e2d', 'h\U0001f600'],
+            [s.encode() for s in latin] + [b'', b'\xff', b'host1\x00'],
+        ]
+        for name, func in self.algorithms:
+            for values in cases:
+                with self.subTest(algorithm=name, last=values[-1]):
+                    k = random.randint(0, len(values) - 1)
+                    self.sorted_index_check(func, list(values), k)
+            with self.subTest(algorithm=name, mixed=True):
+                with self.assertRaises(TypeError):
+                    func(['a', b'b', 'c', b'd'], 2)
+
+    def test_tuple_keys(self):
+        # Tuple keys order their first elements with the typed compares and
+        # only fall back to full tuple comparison on ties.
+        firsts = [
+            lambda: random.randint(0, 20),
+            lambda: random.choice([0.5, 1.5, 2.5]),
+            lambda: random.choice(['a', 'b', 'c\u4e2d']),
+            lambda: None,
+        ]
+        for name, func in self.algorithms:
+            for first in firsts:
+                values = [(first(), random.randint(0, 5), i) for i in range(200)]
+                k = random.randint(0, len(values) - 1)
+                with self.subTest(algorithm=name, first=values[0][0]):
+                    self.sorted_index_check(func, values, k)
+            with self.subTest(algorithm=name, mixed_lengths=True):
+                values = [(1,), (1, 0), (0, 5), (2,), (1, -1), (0,)] * 5
+                self.sorted_index_check(func, values, 13)
+            with self.subTest(algorithm=name, nan=True):
+                values = [(float('nan'), i) for i in range(10)] + [(1.0, 0)]
+                func(values, 5)
+                self.assertEqual(len(values), 11)
+
+    def test_numeric_buffers(self):
+        # Writable numeric buffers are partitioned in place on their raw memory.
+        for name, func in self.algorithms:
+            for typecode in 'bBhHiIlLqQfd':
+                with self.subTest(algorithm=name, typecode=typecode):
+                    hi = {'b': 100, 'B': 100, 'h': 30000, 'H': 30000}.get(typecode, 10**6)
+                    lo = 0 if typecode.isupper() else -hi
+                    values = array.array(
+                        typecode, [random.randint(lo, hi) for _ in range(300)]
+                    )
+                    k = random.randint(0, len(values) - 1)
+                    self.sorted_index_check(func, values, k)
+            with self.subTest(algorithm=name, buffer='memoryview'):
+                data = array.array('d', [random.random() for _ in range(100)])
+                view = memoryview(data)
+                func(view, 50)
+                self.assertEqual(data[50], sorted(data)[50])
+                self.assertEqual(view[50], data[50])
+            with self.subTest(algorithm=name, buffer='bytearray'):
+                data = bytearray(random.randint(0, 255) for _ in range(100))
+                self.sorted_index_check(func, data, 10)
+
+    def test_buffers_in_threads(self):
+        # Buffer selection releases the GIL; concurrent calls on separate
+        # arrays must not interfere with each other.
+        arrays = [
+            array.array('d', [random.random() for _ in range(20000)]) for _ in range(4)
+        ]
+        expected = [sorted(a)[10000] for a in arrays]
+        errors = []
+
+        def worker(values):
+            try:
+                selectlib.nth_element(values, 10000)
+            except Exception as exc:
+                errors.append(exc)
+
+        threads = [threading.Thread(target=worker, args=(a,)) for a in arrays]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        self.assertEqual(errors, [])
+        self.assertEqual([a[10000] for a in arrays], expected)
+
+    def test_shared_list_in_threads(self):
+        # The functions that return values leave the list alone while they
+        # run: another thread sees all of it and may append to it meanwhile.
+        n = 2000
+        values = [random.random() for _ in range(n)]
+        expected = sorted(values)
+        calls = [
+            ('select', lambda data, key: selectlib.select(data, 100, key=key),
+             expected[100]),
+            ('argselect',
+             lambda data, key: data[selectlib.argselect(data, 100, key=key)[100]],
+             expected[100]),
+            ('argselect_many',
+             lambda data, key: data[selectlib.argselect_many(data, [10, 100], key=key)[10]],
+             expected[10]),
+            ('nsmallest', lambda data, key: selectlib.nsmallest(3, data, key=key),
+             expected[:3]),
+            ('nlargest', lambda data, key: selectlib.nlargest(300, data, key=key),
+             expected[:-301:-1]),
+        ]
+        for name, call, result in calls:
+            with self.subTest(function=name):
+                shared = list(values)
+                started = threading.Event()
+                appended = threading.Event()
+                lengths = []
+
+                def key(x):
+                    # Give up the GIL until the other thread has appended.
+                    started.set()
+                    appended.wait(10)
+                    return x
+
+                def writer():
+                    started.wait(10)
+                    lengths.append(len(shared))
+                    shared.append(2.0)
+                    appended.set()
+
+                thread = threading.Thread(target=writer)
+                thread.start()
+                self.assertEqual(call(shared, key), result)
+                thread.join()
+                self.assertEqual(lengths, [n])
+                self.assertEqual(shared, values + [2.0])
+
+    def test_parallel_buffer_select(self):
+        # Large buffers are partitioned on a pool of native threads.
+        n = 200_000
+        for name, func in [
+            ('quickselect', selectlib.quickselect),
+            ('nth_element', selectlib.nth_element),
+        ]:
+            # Each thread gets at least 65536 items, so 7 threads need a
+            # larger buffer, and 1000 threads are capped.
+            for threads, size in ((1, n), (2, n), (7, 500_000), (1000, n)):
+                with self.subTest(algorithm=name, threads=threads):
+                    values = array.array('d', [random.random() for _ in range(size)])
+                    expected = sorted(values)
+                    k = random.randint(size // 16, size - 1)
+                    func(values, k, threads=threads)
+                    self.assertEqual(values[k], expected[k])
+                    self.assertLessEqual(max(values[:k]), values[k])
+                    self.assertGreaterEqual(min(values[k + 1 :]), values[k])
+            with self.subTest(algorithm=name, duplicates=True):
+                values = array.array('i', [random.randint(0, 3) for _ in range(n)])
+                expected = sorted(values)
+                func(values, n // 2, threads=4)
+                self.assertEqual(sorted(values), expected)
+                self.assertEqual(values[n // 2], expected[n // 2])
+            with self.subTest(algorithm=name, invalid=True):
+                with self.assertRaises(ValueError):
+                    func(array.array('d', [1.0]), 0, threads=0)
+            with self.subTest(algorithm=name, list=True):
+                values = [random.random() for _ in range(100)]
+                self.sorted_index_check(lambda v, k: func(v, k, threads=4), values, 50)
+
+    def test_invalid_buffers(self):
+        for name, func in self.algorithms:
+            with self.subTest(algorithm=name):
+                with self.assertRaises(TypeError):
+                    func(b'read-only bytes', 0)
+                with self.assertRaises(TypeError):
+                    func(array.array('u', 'text'), 0)
+                with self.assertRaises(TypeError):
+                    func(array.array('d', [2.0, 1.0]), 0, key=abs)
+                with self.assertRaises(ValueError):
+                    func(memoryview(bytearray(6)).cast('B', (2, 3)), 0)
+                with self.assertRaises(IndexError):
+                    func(array.array('d'), 0)
+
+    def test_subrange(self):
+        # lo/hi select within values[lo:hi] in place; the items outside the
+        # slice are left untouched.
+        n = 3000
+        cases = [
+            [random.randint(0, 10**6) for _ in range(n)],
+            ['s%d' % random.randint(0, 500) for _ in range(n)],
+            array.array('d', [random.random() for _ in range(n)]),
+        ]
+        for name, func in self.algorithms:
+            for values in cases:
+                for lo, hi, k in [(0, 1000, 500), (1000, 2000, 1999),
+                                  (1000, 2000, 1000), (2500, None, 2900),
+                                  (2999, 10**30, 2999)]:
+                    with self.subTest(algorithm=name, first=values[0], lo=lo, hi=hi):
+                        data = values[:]
+                        func(data, k, lo=lo, hi=hi)
+                        end = n if hi is None else min(hi, n)
+                        self.assertEqual(data[:lo], values[:lo])
+                        self.assertEqual(data[end:], values[end:])
+                        expected = sorted(values[lo:end])
+                        self.assertEqual(data[k], expected[k - lo])
+                        self.assertLessEqual(max(data[lo:k + 1]), data[k])
+                        self.assertGreaterEqual(min(data[k:end]), data[k])
+            with self.subTest(algorithm=name, key=True):
+                data = [random.randint(0, 100) for _ in range(n)]
+                before = data[:]
+                func(data, 1500, key=lambda x: -x, lo=1000, hi=2000)
+                self.assertEqual(data[:1000] + data[2000:], before[:1000] + before[2000:])
+                self.assertEqual(data[1500], sorted(before[1000:2000], reverse=True)[500])
+            with self.subTest(algorithm=name, errors=True):
+                for lo, hi, k in [(5, 10, 4), (5, 10, 10), (5, 5, 5), (20, None, 20), (5, 0, 5)]:
+                    with self.assertRaises(IndexError):
+                        func(list(range(20)), k, lo=lo, hi=hi)
+                with self.assertRaises(ValueError):
+                    func(list(range(20)), 5, lo=-1)
+                with self.assertRaises(TypeError):
+                    func(list(range(20)), 5, hi=10.0)
+                with self.assertRaises(TypeError):
+                    func(list(range(20)), 5, 0, 10)
+
+    def test_reverse(self):
+        # reverse=True orders from largest to smallest, as sorted() does.
+        n = 3000
+        cases = [
+            [random.randint(-10**6, 10**6) for _ in range(n)],
+            [random.random() for _ in range(n)],
+            ['s%d' % random.randint(0, 500) for _ in range(n)],
+            [(random.randint(0, 9), random.random()) for _ in range(n)],
+            [random.randint(0, 5) for _ in range(n)],
+            array.array('q', [random.choice([-2**63, 2**63 - 1, 0, -1]) for _ in range(n)]),
+            array.array('B', [random.randint(0, 255) for _ in range(n)]),
+            array.array('f', [random.random() for _ in range(n)]),
+        ]
+        for name, func in self.algorithms:
+            for values in cases:
+                for k in (0, 5, n // 2, n - 1):
+                    with self.subTest(algorithm=name, first=values[0], k=k):
+                        data = values[:]
+                        func(data, k, reverse=True)
+                        expected = sorted(values, reverse=True)
+                        self.assertEqual(data[k], expected[k])
+                        self.assertGreaterEqual(min(data[:k + 1]), data[k])
+                        self.assertLessEqual(max(data[k:]), data[k])
+            with self.subTest(algorithm=name, key=True, subrange=True):
+                data = [random.randint(0, 100) for _ in range(n)]
+                before = data[:]
+                func(data, 1100, key=lambda x: x % 7, lo=1000, hi=2000, reverse=True)
+                self.assertEqual(data[:1000] + data[2000:], before[:1000] + before[2000:])
+                expected = sorted(before[1000:2000], key=lambda x: x % 7, reverse=True)
+                self.assertEqual(data[1100] % 7, expected[100] % 7)
+        for values in cases:
+            with self.subTest(function='nth_elements', first=values[0]):
+                data = values[:]
+                ranks = [0, 10, n // 2, n - 1]
+                selectlib.nth_elements(data, ranks, reverse=True)
+                expected = sorted(values, reverse=True)
+                self.assertEqual([data[r] for r in ranks], [expected[r] for r in ranks])
+            with self.subTest(function='partial_sort', first=values[0]):
+                data = values[:]
+                selectlib.partial_sort(data, 100, reverse=True)
+                self.assertEqual(list(data[:100]), sorted(values, reverse=True)[:100])
+            with self.subTest(function='select', first=values[0]):
+                expected = sorted(values, reverse=True)
+                self.assertEqual(selectlib.select(values, 10, reverse=True), expected[10])
+            if isinstance(values, list):
+                with self.subTest(function='argselect', first=values[0]):
+                    expected = sorted(values, reverse=True)
+                    order = selectlib.argselect(values, 10, reverse=True)
+                    self.assertEqual(values[order[10]], expected[10])
+                    order = selectlib.argselect_many(values, [1, 20], reverse=True)
+                    self.assertEqual([values[order[1]], values[order[20]]],
+                                     [expected[1], expected[20]])
+        with self.subTest(ties=True):
+            # The keys of the sorted prefix descend; partial_sort is not
+            # stable, so equal keys may come out in any order.
+            data = [(random.randint(0, 3), i) for i in range(n)]
+            expected = sorted(data, key=lambda t: t[0], reverse=True)
+            for key in (lambda t: t[0], lambda t: float(t[0])):
+                selectlib.partial_sort(data, n, key=key, reverse=True)
+                self.assertEqual([t[0] for t in data], [t[0] for t in expected])
+                self.assertEqual(sorted(data), sorted(expected))
+
+    def test_nth_elements(self):
+        # Every requested index ends up in its sorted position, with the
+        # items between two requested indices in between their values.
+        def check(values, expected, indices, key=lambda x: x):
+            for k in indices:
+                self.assertEqual(key(values[k]), key(expected[k]))
+            bounds = [0] + sorted(set(indices)) + [len(values)]
+            for lo, hi in zip(bounds, bounds[1:]):
+                block = [key(v) for v in values[lo:hi]]
+                if block:
+                    if lo > 0:
+                        self.assertGreaterEqual(min(block), key(values[lo]))
+                    if hi < len(values):
+                        self.assertLessEqual(max(block), key(values[hi]))
+
+        n = 5000
+        cases = [
+            [random.randint(0, 10**6) for _ in range(n)],
+            [random.random() for _ in range(n)],
+            ['s%d' % random.randint(0, 50) for _ in range(n)],
+            [random.randint(0, 3) for _ in range(n)],
+        ]
+        for values in cases:
+            for indices in ([n // 2], [n - 1, 0, n // 2], [10, 11, 12, 12, 4000],
+                            [n * p // 100 for p in (50, 90, 99)] + [n * 999 // 1000],
+                            random.sample(range(n), 50)):
+                with self.subTest(first=values[0], indices=indices[:5]):
+                    data = list(values)
+                    selectlib.nth_elements(data, indices)
+                    check(data, sorted(values), indices)
+        with self.subTest(key=True):
+            data = list(cases[0])
+            selectlib.nth_elements(data, (100, 2500, 4900), key=lambda x: -x)
+            check(data, sorted(cases[0], key=lambda x: -x), [100, 2500, 4900],
+                  key=lambda x: -x)
+        for typecode in 'idB':
+            with self.subTest(typecode=typecode):
+                data = array.array(typecode, [random.randint(0, 255) for _ in range(n)])
+                expected = sorted(data)
+                selectlib.nth_elements(data, range(0, n, 250))
+                check(data, expected, list(range(0, n, 250)))
+        with self.subTest(empty=True):
+            data = [3, 1, 2]
+            selectlib.nth_elements(data, [])
+            self.assertEqual(data, [3, 1, 2])
+        with self.subTest(small=True):
+            # Short inputs split into empty and single-item subranges.
+            for m in range(1, 40):
+                values = [random.randint(0, 5) for _ in range(m)]
+                indices = random.sample(range(m), random.randint(1, m))
+                for data in (list(values), array.array('i', values),
+                             [float(v) for v in values]):
+                    selectlib.nth_elements(data, indices)
+                    check(data, sorted(data), indices)
+        with self.subTest(errors=True):
+            with self.assertRaises(IndexError):
+                selectlib.nth_elements([3, 1, 2], [0, 3])
+            with self.assertRaises(IndexError):
+                selectlib.nth_elements(array.array('d', [1.0]), [-1])
+            with self.assertRaises(TypeError):
+                selectlib.nth_elements([3, 1, 2], [0.5])
+            with self.assertRaises(TypeError):
+                selectlib.nth_elements([3, 1, 2], 1)
+            with self.assertRaises(TypeError):
+                selectlib.nth_elements('not a list', [0])
+
+    def test_partial_sort(self):
+        n = 5000
+        cases = [
+            [random.randint(0, 10**6) for _ in range(n)],
+            [random.random() for _ in range(n)],
+            ['s%d' % random.randint(0, 50) for _ in range(n)],
+            [(random.randint(0, 3), random.random()) for _ in range(n)],
+            array.array('i', [random.randint(-1000, 1000) for _ in range(n)]),
+            array.array('d', [random.random() for _ in range(n)]),
+        ]
+        for values in cases:
+            for k in (0, 1, 7, 100, n // 2, n - 1, n, n + 10):
+                with self.subTest(first=values[0], k=k):
+                    data = values[:]
+                    selectlib.partial_sort(data, k)
+                    self.assertEqual(list(data[:k]), sorted(values)[:k])
+                    self.assertEqual(sorted(data), sorted(values))
+        with self.subTest(key=True):
+            for values in cases[:2]:
+                data = list(values)
+                selectlib.partial_sort(data, 300, key=lambda x: -x)
+                self.assertEqual(data[:300], sorted(values, key=lambda x: -x)[:300])
+        with self.subTest(errors=True):
+            with self.assertRaises(ValueError):
+                selectlib.partial_sort([3, 1, 2], -1)
+            with self.assertRaises(TypeError):
+                selectlib.partial_sort([3, 'a', 2], 2)
+            with self.assertRaises(TypeError):
+                selectlib.partial_sort(bytes(10), 2)
+            with self.assertRaises(TypeError):
+                selectlib.partial_sort('not a list', 1)
+
+    def test_select(self):
+        n = 3000
+        cases = [
+            [random.randint(0, 10**6) for _ in range(n)],
+            [random.random() for _ in range(n)],
+            ['s%d' % random.randint(0, 50) for _ in range(n)],
+            tuple(random.randint(0, 3) for _ in range(n)),
+            array.array('d', [random.random() for _ in range(n)]),
+            bytes(random.randint(0, 255) for _ in range(n)),
+        ]
+        for values in cases:
+            before = list(values)
+            expected = sorted(values)
+            for k in (0, 1, 100, n // 2, n - 1):
+                with self.subTest(type=type(values).__name__, k=k):
+                    self.assertEqual(selectlib.select(values, k), expected[k])
+            self.assertEqual(list(values), before)
+        with self.subTest(key=True):
+            values = cases[0]
+            self.assertEqual(selectlib.select(values, 10, key=lambda x: -x),
+                             sorted(values, reverse=True)[10])
+        with self.subTest(large=True):
+            # Inputs above the kept scratch size get a scratch array of their
+            # own; smaller ones still reuse the kept one afterwards.
+            values = [random.random() for _ in range((1 << 18) + 1000)]
+            expected = sorted(values)
+            self.assertEqual(selectlib.select(values, 1 << 17), expected[1 << 17])
+            self.assertEqual(selectlib.select(cases[0], 100), sorted(cases[0])[100])
+            self.assertEqual(selectlib.select(values, 1 << 18), expected[1 << 18])
+        with self.subTest(reentrant=True):
+            # A key function that selects itself gets its own scratch array.
+            values = list(range(100))
+            random.shuffle(values)
+            self.assertEqual(
+                selectlib.select(values, 5, key=lambda x: selectlib.select([x, -x, 0], 2)), 5
+            )
+        with self.subTest(errors=True):
+            with self.assertRaises(IndexError):
+                selectlib.select([3, 1, 2], 3)
+            with self.assertRaises(IndexError):
+                selectlib.select((), 0)
+            with self.assertRaises(TypeError):
+                selectlib.select(array.array('i', [1, 2]), 0, key=abs)
+            with self.assertRaises(TypeError):
+                selectlib.select(5, 0)
+
+    def test_argselect(self):
+        def check(values, order, indices, key=lambda x: x):
+            self.assertEqual(sorted(order), list(range(len(values))))
+            ranked = [key(values[i]) for i in order]
+            expected = sorted(key(v) for v in values)
+            for k in indices:
+                self.assertEqual(ranked[k], expected[k])
+            bounds = [0] + sorted(set(indices)) + [len(values)]
+            for lo, hi in zip(bounds, bounds[1:]):
+                block = ranked[lo:hi]
+                if block and lo > 0:
+                    self.assertGreaterEqual(min(block), ranked[lo])
+                if block and hi < len(values):
+                    self.assertLessEqual(max(block), ranked[hi])
+
+        n = 3000
+        cases = [
+            [random.randint(0, 10**6) for _ in range(n)],
+            [random.random() for _ in range(n)],
+            ['s%d' % random.randint(0, 50) for _ in range(n)],
+            [random.randint(0, 3) for _ in range(n)],
+        ]
+        for values in cases:
+            before = list(values)
+            for k in (0, 1, n // 2, n - 1):
+                with self.subTest(first=values[0], k=k):
+                    check(values, selectlib.argselect(values, k), [k])
+            with self.subTest(first=values[0], many=True):
+                indices = [10, 11, n // 2, n - 5]
+                check(values, selectlib.argselect_many(values, indices), indices)
+            self.assertEqual(values, before)
+        with self.subTest(key=True):
+            order = selectlib.argselect(cases[0], 100, key=lambda x: -x)
+            check(cases[0], order, [100], key=lambda x: -x)
+        with self.subTest(empty=True):
+            order = selectlib.argselect_many([3, 1, 2], [])
+            self.assertIsInstance(order, array.array)
+            self.assertEqual(order.tolist(), [0, 1, 2])
+            self.assertEqual(len(selectlib.argselect_many([], [])), 0)
+        with self.subTest(errors=True):
+            with self.assertRaises(IndexError):
+                selectlib.argselect([3, 1, 2], 3)
+            with self.assertRaises(TypeError):
+                selectlib.argselect([3, 'a', 2], 1)
+            with self.assertRaises(TypeError):
+                selectlib.argselect(5, 1)
+
+    def test_nsmallest_nlargest(self):
+        cases = [
+            [random.randint(0, 10**6) for _ in range(3000)],
+            [random.random() for _ in range(3000)],
+            ['s%d' % random.randint(0, 50) for _ in range(500)],
+            [random.choice([1, 1.0, True, 2, 2.0]) for _ in range(200)],
+            [(random.randint(0, 3), i) for i in range(100)],
+            [],
+        ]
+        keys = [None, lambda x: x[0] if isinstance(x, tuple) else str(x)[:2], lambda x: 0]
+        for values in cases:
+            for n in (-1, 0, 1, 5, 40, len(values) // 2, len(values), len(values) + 1):
+                for key in keys:
+                    with self.subTest(first=values[:1], n=n, key=key):
+                        for ours, theirs in ((selectlib.nsmallest, heapq.nsmallest),
+                                             (selectlib.nlargest, heapq.nlargest)):
+                            got = ours(n, iter(values), key=key)
+                            expected = theirs(n, iter(values), key=key)
+                            # Equal items must come out in heapq's order.
+                            self.assertEqual([id(x) for x in got], [id(x) for x in expected])
+        with self.subTest(errors=True):
+            with self.assertRaises(TypeError):
+                selectlib.nsmallest(2, [3, 'a', 1])
+            with self.assertRaises(TypeError):
+                selectlib.nlargest(2, 5)
+            with self.assertRaises(TypeError):
+                selectlib.nsmallest(2, [3, 1], key=5)
+
+    def test_quantiles(self):
+        def reference(values, q, method):
+            data = sorted(values)
+            h = (len(data) - 1) * q
+            lo, hi = math.floor(h), math.ceil(h)
+            if method == 'lower':
+                return data[lo]
+            if method == 'higher':
+                return data[hi]
+            if method == 'nearest':
+                return data[round(h)]
+            if method == 'midpoint':
+                return data[lo] if lo == hi else (data[lo] + data[hi]) / 2
+            return data[lo] + (data[hi] - data[lo]) * (h - lo)
+
+        qs = [0, 0.001, 0.25, 0.5, 0.9, 0.99, 0.999, 1, 0.5, 0.125]
+        cases = [
+            [random.randint(-1000, 1000) for _ in range(1001)],
+            [random.random() for _ in range(2000)],
+            [random.randint(0, 3) for _ in range(9)],
+            [42],
+            array.array('d', [random.random() for _ in range(999)]),
+            array.array('i', [random.randint(-1000, 1000) for _ in range(500)]),
+        ]
+        for values in cases:
+            before = list(values)
+            for method in ('linear', 'lower', 'higher', 'nearest', 'midpoint'):
+                with self.subTest(n=len(values), method=method):
+                    result = selectlib.quantiles(values, qs, method=method)
+                    expected = [reference(before, q, method) for q in qs]
+                    for got, want in zip(result, expected):
+                        self.assertAlmostEqual(got, want)
+                    self.assertEqual(list(values), before)
+        with self.subTest(strings=True):
+            words = ['s%03d' % i for i in range(101)]
+            random.shuffle(words)
+            self.assertEqual(
+                selectlib.quantiles(words, [0.1, 0.5], method='lower'), ['s010', 's050']
+            )
+        with self.subTest(readonly=True):
+            data = bytes(range(11))
+            self.assertEqual(selectlib.quantiles(data, [0.5, 0.95]), [5, 9.5])
+        with self.subTest(exact=True):
+            # Decimal and Fraction values keep their type, weighted by the
+            # exact decimal ratio of the position's fraction.
+            values = [decimal.Decimal(2), decimal.Decimal(1)]
+            self.assertEqual(selectlib.quantiles(values, [0.25, 0.3, 0.5]),
+                             [decimal.Decimal('1.25'), decimal.Decimal('1.3'),
+                              decimal.Decimal('1.5')])
+            self.assertEqual(selectlib.quantiles(values, [0.5], method='midpoint'),
+                             [decimal.Decimal('1.5')])
+            values = [fractions.Fraction(n, 3) for n in range(4)]
+            result = selectlib.quantiles(values, [0.1, 0.5])
+            self.assertEqual(result, [fractions.Fraction(1, 10), fractions.Fraction(1, 2)])
+            self.assertIsInstance(result[0], fractions.Fraction)
+            # The positions come from the exact rank too: 100 * 0.29 is 29,
+            # although 100 * 0.29 as a float is just below it.
+            values = [decimal.Decimal(i) for i in range(101)]
+            qs = [0.29, 0.57, 0.58]
+            for method in ('linear', 'lower', 'higher', 'nearest', 'midpoint'):
+                self.assertEqual(selectlib.quantiles(values, qs, method=method),
+                                 [29, 57, 58])
+            self.assertEqual(selectlib.quantiles(values[:4], [0.5, 0.5 / 3],
+                                                 method='nearest'),
+                             [2, 0])
+        with self.subTest(errors=True):
+            self.assertEqual(selectlib.quantiles([], []), [])
+            with self.assertRaises(ValueError):
+                selectlib.quantiles([], [0.5])
+            with self.assertRaises(ValueError):
+                selectlib.quantiles([1, 2], [1.5])
+            with self.assertRaises(ValueError):
+                selectlib.quantiles([1, 2], [float('nan')])
+            with self.assertRaises(ValueError):
+                selectlib.quantiles([1, 2], [0.5], method='cubic')
+            with self.assertRaises(TypeError):
+                selectlib.quantiles(['a', 'b'], [0.5])
+            with self.assertRaises(TypeError):
+                selectlib.quantiles(5, [0.5])
+
+    def test_median(self):
+        cases = [
+            [random.randint(-1000, 1000) for _ in range(1000)],
+            [random.randint(-1000, 1000) for _ in range(1001)],
+            [random.random() for _ in range(5000)],
+            [random.randint(0, 3) for _ in range(10)],
+            [42],
+            [1, 2],
+            array.array('d', [random.random() for _ in range(3000)]),
+            array.array('i', [random.randint(-1000, 1000) for _ in range(500)]),
+        ]
+        for values in cases:
+            before = list(values)
+            data = sorted(before)
+            low, high = data[(len(data) - 1) // 2], data[len(data) // 2]
+            with self.subTest(n=len(values)):
+                self.assertEqual(selectlib.median(values), low)
+                self.assertEqual(selectlib.median(values, kind='low'), low)
+                self.assertEqual(selectlib.median(values, kind='high'), high)
+                self.assertAlmostEqual(selectlib.median(values, kind='mean'), (low + high) / 2)
+                self.assertEqual(list(values), before)
+        with self.subTest(key=True):
+            values = [random.random() for _ in range(4000)]
+            data = sorted(values, key=lambda x: -x)
+            self.assertEqual(selectlib.median(values, key=lambda x: -x, kind='high'), data[2000])
+            self.assertAlmostEqual(
+                selectlib.median(values, key=lambda x: -x, kind='mean'), (data[1999] + data[2000]) / 2
+            )
+        with self.subTest(errors=True):
+            with self.assertRaises(ValueError):
+                selectlib.median([])
+            with self.assertRaises(ValueError):
+                selectlib.median([1, 2], kind='middle')
+            with self.assertRaises(TypeError):
+                selectlib.median(array.array('i', [1, 2]), key=abs)
+            with self.assertRaises(TypeError):
+                selectlib.median(5)
+
     def test_non_list_input(self):
         for name, func in self.algorithms:
             with self.subTest(algorithm=name):
                 with self.assertRaises(TypeError):
                     func('not a list', 0)
 
+    def test_mutable_sequence_input(self):
+        # Mutable sequences other than lists are partitioned in place too;
+        # immutable sequences and other iterables cannot be.
+        n = 2000
+        values = [random.randint(0, 10**6) for _ in range(n)]
+        expected = sorted(values)
+        for name, func in self.algorithms:
+            for kind in (collections.deque, collections.UserList):
+                with self.subTest(algorithm=name, kind=kind.__name__):
+                    data = kind(values)
+                    func(data, 700)
+                    self.assertEqual(data[700], expected[700])
+                    self.assertLessEqual(max(list(data)[:700]), data[700])
+                    self.assertGreaterEqual(min(list(data)[700:]), data[700])
+                with self.subTest(algorithm=name, kind=kind.__name__, subrange=True):
+                    data = kind(values)
+                    func(data, 1500, lo=1000, hi=2000, reverse=True)
+                    self.assertEqual(list(data)[:1000], values[:1000])
+                    self.assertEqual(data[1500], sorted(values[1000:], reverse=True)[500])
+            with self.subTest(algorithm=name, immutable=True):
+                for immutable in (tuple(values), range(n), iter(values)):
+                    with self.assertRaises(TypeError):
+                        func(immutable, 0)
+        with self.subTest(function='nth_elements'):
+            data = collections.deque(values)
+            selectlib.nth_elements(data, [10, 1000])
+            self.assertEqual([data[10], data[1000]], [expected[10], expected[1000]])
+        with self.subTest(function='partial_sort'):
+            data = collections.UserList(values)
+            selectlib.partial_sort(data, 50)
+            self.assertEqual(list(data[:50]), expected[:50])
+            with self.assertRaises(TypeError):
+                selectlib.partial_sort(tuple(values), 50)
+        with self.subTest(slice_assignment=True):
+            # Sequences with slice assignment are written back in one call.
+            class CountingList(collections.UserList):
+                def __setitem__(self, index, value):
+                    calls.append(index)
+                    super().__setitem__(index, value)
+
+            calls = []
+            data = CountingList(values)
+            selectlib.quickselect(data, 700, lo=100)
+            self.assertEqual(calls, [slice(100, n)])
+            self.assertEqual(data[700], sorted(values[100:])[600])
+
+    def test_iterable_input(self):
+        # The functions that return values accept any iterable and read it once.
+        n = 1001
+        values = [random.random() for _ in range(n)]
+        expected = sorted(values)
+        mapping = {i: v for i, v in enumerate(values)}
+        interleaved = array.array('d', [x for v in values for x in (v, -1.0)])
+        for kind, make in [
+            ('generator', lambda: (v for v in values)),
+            ('dict values', lambda: mapping.values()),
+            ('deque', lambda: collections.deque(values)),
+            ('tuple', lambda: tuple(values)),
+            ('strided memoryview', lambda: memoryview(interleaved)[::2]),
+        ]:
+            with self.subTest(kind=kind):
+                self.assertEqual(selectlib.select(make(), 10), expected[10])
+                self.assertEqual(selectlib.select(make(), 10, reverse=True), expected[-11])
+                self.assertEqual(selectlib.median(make()), expected[500])
+                self.assertEqual(selectlib.quantiles(make(), [0.0, 1.0]),
+                                 [expected[0], expected[-1]])
+                order = selectlib.argselect(make(), 500)
+                self.assertEqual(values[order[500]], expected[500])
+                self.assertEqual(sorted(order), list(range(n)))
+                order = selectlib.argselect_many(make(), [1, 999])
+                self.assertEqual([values[order[1]], values[order[999]]],
+                                 [expected[1], expected[999]])
+        with self.subTest(kind='dict keys'):
+            self.assertEqual(selectlib.median(mapping.keys()), 500)
+            self.assertEqual(selectlib.select(range(100, 0, -1), 0), 1)
+        with self.subTest(kind='text buffer'):
+            # Buffers that are not numeric are read as sequences too.
+            text = array.array('w' if 'w' in array.typecodes else 'u', 'cab')
+            self.assertEqual(selectlib.select(text, 0), 'a')
+            self.assertEqual(selectlib.median(text), 'b')
+            self.assertEqual(list(selectlib.argselect(text, 0))[0], 1)
+
     def test_out_of_range_index(self):
         for name, func in self.algorithms:
             with self.subTest(algorithm=name):